@@ -0,0 +1,228 @@
+/*
+ * Microbenchmark of the C shims of the snf package against the
+ * synthetic SNF implementation in snf/mockup.h. Every layer is
+ * measured in TSC cycles and nanoseconds per packet so the cost of
+ * the bridging code can be told apart from the cost of SNF itself.
+ * The matching Go benchmarks are in snf/bench_test.go, their ns/op
+ * compares with ns/pkt. TSC cycles have no Go counterpart since TSC
+ * rate generally differs from the current CPU frequency.
+ *
+ * Build and run from this directory:
+ *
+ *   cc -O2 -DUSE_MOCKUP -I../../snf -o cbench main.c && ./cbench [npkts [burst]]
+ *
+ * Synthetic traffic is configured with the environment variables
+ * described in snf/mockup.h, e.g. SNF_MOCKUP_PKT_LEN.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "wrapper.h"
+#include "ring_reader.h"
+#include "inject_template.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() 0ULL
+#endif
+
+struct result {
+	uint64_t pkts;
+	uint64_t cycles;
+	uint64_t ns;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void report(const char *name, struct result *r)
+{
+	printf("%-28s %10.1f cycles/pkt %8.1f ns/pkt\n", name,
+	       (double)r->cycles / r->pkts, (double)r->ns / r->pkts);
+}
+
+/*
+ * The snf_* calls are static functions of mockup.h, so the compiler
+ * barrier keeps the calls from being merged across iterations.
+ */
+#define barrier() __asm__ __volatile__("" ::: "memory")
+
+#define BENCH(name, npkts, res, body)				\
+	do {							\
+		uint64_t c0 = cycles(), t0 = now_ns();		\
+		for ((res).pkts = 0; (res).pkts < (npkts);) {	\
+			body;					\
+			barrier();				\
+		}						\
+		(res).cycles = cycles() - c0;			\
+		(res).ns = now_ns() - t0;			\
+		report(name, &(res));				\
+	} while (0)
+
+static void fail(const char *what, int rc)
+{
+	fprintf(stderr, "%s: %s\n", what, strerror(rc));
+	exit(1);
+}
+
+static void bench_recv(snf_ring_t ring, uint64_t npkts, int burst)
+{
+	struct snf_recv_req *reqs = calloc(burst, sizeof(*reqs));
+	struct snf_ring_qinfo qinfo;
+	struct ring_reader *reader;
+	struct result res;
+	int rc, i, n;
+
+	BENCH("snf_ring_recv", npkts, res, {
+		if ((rc = snf_ring_recv(ring, 0, &reqs[0])) == 0)
+			res.pkts++;
+		else if (rc != EAGAIN)
+			fail("snf_ring_recv", rc);
+	});
+
+	// return the last packet of the previous benchmark
+	snf_ring_recv_many(ring, 0, reqs, 0, &n, NULL);
+
+	BENCH("snf_ring_recv_many", npkts, res, {
+		if ((rc = snf_ring_recv_many(ring, 0, reqs, burst, &n, &qinfo)) == 0) {
+			uint32_t len = 0;
+			for (i = 0; i < n; i++)
+				len += reqs[i].length_data;
+			snf_ring_return_many(ring, len, &qinfo);
+			res.pkts += n;
+		} else if (rc != EAGAIN) {
+			fail("snf_ring_recv_many", rc);
+		}
+	});
+
+	BENCH("ring_recv_many (shim)", npkts, res, {
+		struct compound_int out = ring_recv_many(ring, 0, reqs, burst, &qinfo);
+		if (out.rc == 0) {
+			uint32_t len = 0;
+			for (i = 0; i < out.i[0]; i++)
+				len += reqs[i].length_data;
+			snf_ring_return_many(ring, len, &qinfo);
+			res.pkts += out.i[0];
+		} else if (out.rc != EAGAIN) {
+			fail("ring_recv_many", out.rc);
+		}
+	});
+
+	reader = calloc(1, ring_reader_size(burst));
+	reader->ringh = ring;
+	reader->nreq_in = reader->nreq_cur = reader->nreq_min = burst;
+
+	BENCH("ring_reader_recharge", npkts, res, {
+		if ((rc = ring_reader_recharge(reader)) == 0)
+			res.pkts += reader->nreq_out;
+		else if (rc != EAGAIN)
+			fail("ring_reader_recharge", rc);
+	});
+
+	ring_reader_return_many(reader);
+	free(reader);
+	free(reqs);
+}
+
+static void bench_inject(snf_inject_t inj, uint64_t npkts, int burst)
+{
+	uint8_t pkt[64] = { 0 };
+	struct snf_pkt_fragment frags[2] = {
+		{ .ptr = pkt, .length = 42 },
+		{ .ptr = pkt + 42, .length = 22 },
+	};
+	struct snf_recv_req *reqs = calloc(burst, sizeof(*reqs));
+	struct inject_template *t;
+	struct result res;
+	int rc, i;
+
+	BENCH("snf_inject_send", npkts, res, {
+		if ((rc = snf_inject_send(inj, 0, 0, pkt, sizeof(pkt))) != 0)
+			fail("snf_inject_send", rc);
+		res.pkts++;
+	});
+
+	BENCH("snf_inject_send_v", npkts, res, {
+		if ((rc = snf_inject_send_v(inj, 0, 0, frags, 2, sizeof(pkt))) != 0)
+			fail("snf_inject_send_v", rc);
+		res.pkts++;
+	});
+
+	for (i = 0; i < burst; i++) {
+		reqs[i].pkt_addr = pkt;
+		reqs[i].length = sizeof(pkt);
+	}
+
+	BENCH("inject_recv_reqs (shim)", npkts, res, {
+		struct compound_int out = inject_recv_reqs(inj, 0, 0, reqs, burst);
+		if (out.rc != 0)
+			fail("inject_recv_reqs", out.rc);
+		res.pkts += out.i[0];
+	});
+
+	// Ethernet, IPv4 and UDP headers with 22 bytes of payload
+	pkt[12] = 0x08;
+	pkt[14] = 0x45;
+	pkt[17] = 50;
+	pkt[22] = 64;
+	pkt[23] = 17;
+	pkt[39] = 30;
+	if ((t = inject_template_alloc(pkt, sizeof(pkt))) == NULL)
+		fail("inject_template_alloc", errno);
+	inject_template_add_field(t, t->l4_off, 2, 1024, 1, 1024);
+
+	BENCH("inject_template_send", npkts, res, {
+		struct compound_int out = inject_template_send(inj, 0, 0, t,
+				res.pkts, burst, 0);
+		if (out.rc != 0)
+			fail("inject_template_send", out.rc);
+		res.pkts += out.i[0];
+	});
+
+	inject_template_free(t);
+	free(reqs);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t npkts = argc > 1 ? strtoull(argv[1], NULL, 0) : 10000000;
+	int burst = argc > 2 ? atoi(argv[2]) : 256;
+	snf_handle_t h;
+	snf_ring_t ring;
+	snf_inject_t inj;
+	int rc;
+
+	setenv("SNF_NUM_RINGS", "1", 0);
+	setenv("SNF_DATARING_SIZE", "64", 0);
+
+	if ((rc = snf_init(SNF_VERSION_API)) != 0)
+		fail("snf_init", rc);
+	if ((rc = snf_open(0, 0, NULL, 0, -1, &h)) != 0)
+		fail("snf_open", rc);
+	if ((rc = snf_ring_open(h, &ring)) != 0)
+		fail("snf_ring_open", rc);
+	if ((rc = snf_start(h)) != 0)
+		fail("snf_start", rc);
+
+	printf("%llu packets, burst %d\n", (unsigned long long)npkts, burst);
+	bench_recv(ring, npkts, burst);
+
+	if ((rc = snf_inject_open(0, 0, &inj)) != 0)
+		fail("snf_inject_open", rc);
+	bench_inject(inj, npkts, burst);
+
+	snf_inject_close(inj);
+	snf_ring_close(ring);
+	snf_close(h);
+	return 0;
+}
@@ -0,0 +1,178 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+#include "ring_reader.h"
+*/
+import "C"
+
+import (
+	"os"
+	"runtime"
+	"sync/atomic"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// AggReader receives packets from an aggregated ring (see
+// AggregatePortMask flag) in bursts. Since snf_ring_recv_many()
+// doesn't work with aggregated rings, AggReader opens a RingReader on
+// each of the physical rings returned by the ring's PortInfo() and
+// polls them round-robin within a single cgo call.
+//
+// The packets are delivered in bursts of the physical rings, so
+// there's no ordering guarantee across ports.
+type AggReader struct {
+	readers []*RingReader
+	vec     **C.struct_ring_reader
+	cur     C.int
+
+	stopped uint32
+	sig     os.Signal
+	err     error
+}
+
+// NewAggReader creates new AggReader. timeout and burst semantics is
+// the same as in NewReader() and applies to each physical ring. If
+// none of the physical rings has packets available, the reader blocks
+// on one of them for at most timeout, so it should be kept small.
+func NewAggReader(r *Ring, timeout time.Duration, burst int) (*AggReader, error) {
+	pi, err := r.PortInfo()
+	if err != nil {
+		return nil, err
+	}
+
+	if len(pi) == 0 {
+		return nil, syscall.ENODEV
+	}
+
+	a := &AggReader{}
+	ptrSize := unsafe.Sizeof(a.vec)
+	a.vec = (**C.struct_ring_reader)(C.malloc(C.size_t(uintptr(len(pi)) * ptrSize)))
+	for i := range pi {
+		rr := NewReader(pi[i].Ring(), timeout, burst)
+		a.readers = append(a.readers, rr)
+		p := unsafe.Pointer(uintptr(unsafe.Pointer(a.vec)) + uintptr(i)*ptrSize)
+		*(**C.struct_ring_reader)(p) = rr.reader
+	}
+
+	// start polling from the first ring
+	a.cur = C.int(len(pi) - 1)
+	runtime.SetFinalizer(a, func(a *AggReader) {
+		C.free(unsafe.Pointer(a.vec))
+	})
+	return a, nil
+}
+
+// Readers returns RingReader of each physical ring.
+func (a *AggReader) Readers() []*RingReader {
+	return a.readers
+}
+
+func (a *AggReader) current() *RingReader {
+	return a.readers[a.cur]
+}
+
+func (a *AggReader) recharge() bool {
+	if atomic.LoadUint32(&a.stopped) > 0 {
+		a.err = &ErrSignal{a.sig}
+		return false
+	}
+
+	rc := C.ring_reader_recharge_any(a.vec, C.int(len(a.readers)), &a.cur)
+	rr := a.current()
+	ok := rr.recharged(rc)
+	a.err = rr.err
+	return ok
+}
+
+// Next gets next packet out of any of the physical rings. It follows
+// the semantics of RingReader's Next().
+func (a *AggReader) Next() bool {
+	if rr := a.current(); rr.n+1 < len(rr.burst) {
+		ok := rr.Next()
+		a.err = rr.err
+		return ok
+	}
+
+	if !a.recharge() {
+		return false
+	}
+
+	a.current().n = 0
+	return true
+}
+
+// NextBatch gets next burst of packets out of any of the physical
+// rings. It follows the semantics of RingReader's NextBatch().
+func (a *AggReader) NextBatch() []RecvReq {
+	if rr := a.current(); rr.n+1 < len(rr.burst) {
+		return rr.NextBatch()
+	}
+
+	if !a.recharge() {
+		return nil
+	}
+
+	rr := a.current()
+	rr.n = -1
+	return rr.NextBatch()
+}
+
+// LoopNext is similar to Next() method but this one loops if EAGAIN
+// is encountered.
+func (a *AggReader) LoopNext() bool {
+	for !a.Next() {
+		if a.Err() != syscall.EAGAIN {
+			return false
+		}
+	}
+	return true
+}
+
+// RecvReq returns current packet descriptor. See RingReader's
+// RecvReq().
+func (a *AggReader) RecvReq() *RecvReq {
+	return a.current().RecvReq()
+}
+
+// Data gets retrieved packet's data. See RingReader's Data().
+func (a *AggReader) Data() []byte {
+	return a.current().Data()
+}
+
+// Err returns error which was encountered during the last AggReader
+// operation.
+func (a *AggReader) Err() error {
+	return a.err
+}
+
+// Free returns all packets that were retrieved on all physical rings.
+func (a *AggReader) Free() error {
+	for _, rr := range a.readers {
+		rr.Free()
+	}
+	return nil
+}
+
+// NotifyWith installs signal notification channel which is presumably
+// registered via signal.Notify.
+//
+// Please note that this function expects that specified channel is
+// closed at some point to release acquired resources.
+func (a *AggReader) NotifyWith(ch <-chan os.Signal) {
+	go func() {
+		for sig := range ch {
+			a.sig = sig
+			atomic.StoreUint32(&a.stopped, 1)
+			break
+		}
+	}()
+}
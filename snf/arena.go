@@ -0,0 +1,114 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"unsafe"
+)
+
+// ArenaChunkSize is the default size of an Arena chunk. It fits a
+// jumbo 9000-byte frame.
+const ArenaChunkSize = 9216
+
+// Arena is a slab allocator of fixed-size chunks which may be used to
+// retain packets beyond the lifetime of a burst without allocating
+// memory per packet. Chunks are recycled either explicitly with
+// Release() or all at once with Reset().
+//
+// Arena is not safe for concurrent use.
+type Arena struct {
+	chunkSize int
+	slabs     [][]byte
+
+	// free chunks offsets for each slab
+	free [][]int32
+}
+
+// NewArena creates an Arena with initial capacity of n chunks of
+// chunkSize bytes each. If chunkSize is not positive, ArenaChunkSize is
+// used. Arena grows by doubling its capacity if it runs out of free
+// chunks.
+func NewArena(n, chunkSize int) *Arena {
+	if chunkSize <= 0 {
+		chunkSize = ArenaChunkSize
+	}
+	if n <= 0 {
+		n = 1
+	}
+
+	a := &Arena{chunkSize: chunkSize}
+	a.grow(n)
+	return a
+}
+
+func (a *Arena) grow(n int) {
+	free := make([]int32, n)
+	for i := range free {
+		free[i] = int32(n - i - 1)
+	}
+	a.slabs = append(a.slabs, make([]byte, n*a.chunkSize))
+	a.free = append(a.free, free)
+}
+
+// ChunkSize returns the size of arena chunks.
+func (a *Arena) ChunkSize() int {
+	return a.chunkSize
+}
+
+// Get returns a zero-length slice with the capacity of a chunk.
+func (a *Arena) Get() []byte {
+	for i, free := range a.free {
+		if n := len(free); n > 0 {
+			off := int(free[n-1]) * a.chunkSize
+			a.free[i] = free[:n-1]
+			return a.slabs[i][off : off : off+a.chunkSize]
+		}
+	}
+
+	a.grow(len(a.slabs[len(a.slabs)-1]) / a.chunkSize * 2)
+	return a.Get()
+}
+
+// Copy returns a copy of data backed by an arena chunk. If data
+// doesn't fit into a chunk it is copied to a newly allocated slice.
+func (a *Arena) Copy(data []byte) []byte {
+	if len(data) > a.chunkSize {
+		return append(make([]byte, 0, len(data)), data...)
+	}
+	return append(a.Get(), data...)
+}
+
+// Release returns the chunk backing b to the arena. b should be
+// obtained from Get() or Copy(). Slices not backed by the arena are
+// ignored.
+func (a *Arena) Release(b []byte) {
+	if cap(b) == 0 {
+		return
+	}
+
+	p := uintptr(unsafe.Pointer(&b[:1][0]))
+	for i, slab := range a.slabs {
+		base := uintptr(unsafe.Pointer(&slab[0]))
+		if p >= base && p < base+uintptr(len(slab)) {
+			a.free[i] = append(a.free[i], int32((p-base)/uintptr(a.chunkSize)))
+			return
+		}
+	}
+}
+
+// Reset returns all chunks to the arena. Previously obtained slices
+// may not be used after that.
+func (a *Arena) Reset() {
+	for i, slab := range a.slabs {
+		n := len(slab) / a.chunkSize
+		free := a.free[i][:0]
+		for j := n - 1; j >= 0; j-- {
+			free = append(free, int32(j))
+		}
+		a.free[i] = free
+	}
+}
@@ -0,0 +1,266 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"testing"
+	"time"
+
+	"github.com/google/gopacket/layers"
+	"github.com/yerden/go-snf/snf"
+)
+
+// benchStart resets the timer of benchmarks with a packet per
+// iteration. ns/op of such benchmarks is ns/pkt and is comparable
+// with examples/cbench output.
+func benchStart(b *testing.B) {
+	b.ReportAllocs()
+	b.ResetTimer()
+}
+
+// benchReader sets up synthetic ring with packets of specified length
+// and returns RingReader on it. Every benchmark iteration corresponds
+// to a single packet so ns/op is ns per packet.
+func benchReader(b *testing.B, pktLen string, burst int) (*snf.RingReader, func()) {
+	return mockupReader(b, "64", pktLen, time.Second, burst)
+}
+
+func BenchmarkRingRecv(b *testing.B) {
+	rr, teardown := benchReader(b, "64", 1)
+	defer teardown()
+
+	r := rr.Ring()
+	var req snf.RecvReq
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if err := r.Recv(time.Second, &req); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkRingRecvMany(b *testing.B) {
+	rr, teardown := benchReader(b, "64", 1)
+	defer teardown()
+
+	r := rr.Ring()
+	reqs := make([]snf.RecvReq, 256)
+	var qinfo snf.RingQInfo
+	benchStart(b)
+	for i := 0; i < b.N; {
+		n, err := r.RecvMany(time.Second, reqs, &qinfo)
+		if err != nil {
+			b.Fatal(err)
+		}
+		if err = r.ReturnMany(reqs[:n], &qinfo); err != nil {
+			b.Fatal(err)
+		}
+		i += n
+	}
+}
+
+func benchNext(b *testing.B, burst int) {
+	rr, teardown := benchReader(b, "64", burst)
+	defer teardown()
+
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if !rr.Next() {
+			b.Fatal(rr.Err())
+		}
+	}
+}
+
+func BenchmarkRingReaderNext1(b *testing.B) {
+	benchNext(b, 1)
+}
+
+func BenchmarkRingReaderNext32(b *testing.B) {
+	benchNext(b, 32)
+}
+
+func BenchmarkRingReaderNext256(b *testing.B) {
+	benchNext(b, 256)
+}
+
+func BenchmarkRingReaderNextBatch(b *testing.B) {
+	rr, teardown := benchReader(b, "64", 256)
+	defer teardown()
+
+	benchStart(b)
+	for i := 0; i < b.N; {
+		reqs := rr.NextBatch()
+		if reqs == nil {
+			b.Fatal(rr.Err())
+		}
+		for j := range reqs {
+			handleReq(&reqs[j])
+		}
+		i += len(reqs)
+	}
+}
+
+func BenchmarkZeroCopyReadPacketData(b *testing.B) {
+	rr, teardown := benchReader(b, "64-1518", 256)
+	defer teardown()
+
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if _, _, err := rr.ZeroCopyReadPacketData(); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkReadPacketData(b *testing.B) {
+	rr, teardown := benchReader(b, "64-1518", 256)
+	defer teardown()
+
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if _, _, err := rr.ReadPacketData(); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkDecode(b *testing.B) {
+	rr, teardown := benchReader(b, "64-1518", 256)
+	defer teardown()
+
+	var udp int
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if !rr.Next() {
+			b.Fatal(rr.Err())
+		}
+		if d, err := rr.Decode(); err == nil && d.Has(layers.LayerTypeUDP) {
+			udp++
+		}
+	}
+
+	if udp != b.N {
+		b.Fatal("decoded", udp, "UDP packets out of", b.N)
+	}
+}
+
+func BenchmarkForward(b *testing.B) {
+	rr, teardown := benchReader(b, "64", 256)
+	defer teardown()
+
+	s, closeSender := benchSender(b)
+	defer closeSender()
+
+	benchStart(b)
+	for i := 0; i < b.N; {
+		reqs := rr.NextBatch()
+		if reqs == nil {
+			b.Fatal(rr.Err())
+		}
+		n, err := s.Forward(reqs)
+		if err != nil {
+			b.Fatal(err)
+		}
+		i += n
+	}
+}
+
+func benchSender(b *testing.B) (*snf.Sender, func()) {
+	assertFail := newAssert(b, true)
+	assertFail(snf.Init() == nil)
+
+	inj, err := snf.OpenInjectHandle(0)
+	assertFail(err == nil, err)
+
+	return snf.NewSender(inj, time.Second, 0), func() {
+		inj.Close()
+	}
+}
+
+func BenchmarkSend(b *testing.B) {
+	s, teardown := benchSender(b)
+	defer teardown()
+
+	pkt := make([]byte, 64)
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if err := s.Send(pkt); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkSendVec(b *testing.B) {
+	s, teardown := benchSender(b)
+	defer teardown()
+
+	hdr, payload := make([]byte, 42), make([]byte, 22)
+	benchStart(b)
+	for i := 0; i < b.N; i++ {
+		if err := s.SendVec(hdr, payload); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkSendBatch(b *testing.B) {
+	s, teardown := benchSender(b)
+	defer teardown()
+
+	pkts := make([][]byte, 256)
+	for i := range pkts {
+		pkts[i] = make([]byte, 64)
+	}
+
+	benchStart(b)
+	for i := 0; i < b.N; {
+		n := len(pkts)
+		if b.N-i < n {
+			n = b.N - i
+		}
+		if _, err := s.SendBatch(pkts[:n]); err != nil {
+			b.Fatal(err)
+		}
+		i += n
+	}
+}
+
+func BenchmarkSendTemplate(b *testing.B) {
+	s, teardown := benchSender(b)
+	defer teardown()
+
+	// Ethernet, IPv4 and UDP headers with 22 bytes of payload
+	frame := make([]byte, 64)
+	frame[12], frame[13] = 0x08, 0x00
+	frame[14], frame[16], frame[17] = 0x45, 0, 50
+	frame[22], frame[23] = 64, 17
+	frame[38], frame[39] = 0, 30
+
+	t, err := snf.NewInjectTemplate(frame)
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer t.Free()
+
+	if err := t.Vary(snf.TmplSrcPort, 0, 1, 1024); err != nil {
+		b.Fatal(err)
+	}
+
+	benchStart(b)
+	for i := 0; i < b.N; {
+		n := 256
+		if b.N-i < n {
+			n = b.N - i
+		}
+		if _, err := s.SendTemplate(t, uint64(i), n); err != nil {
+			b.Fatal(err)
+		}
+		i += n
+	}
+}
@@ -0,0 +1,97 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+#include "bpf_filter.h"
+*/
+import "C"
+
+import (
+	"syscall"
+	"unsafe"
+)
+
+// BPFInstruction is a classic BPF instruction. It is binary
+// compatible with struct sock_filter and libpcap's struct bpf_insn.
+// Programs may be obtained with 'tcpdump -dd <expression>' or by
+// compiling the expression with libpcap, e.g. gopacket/pcap's
+// CompileBPFFilter().
+type BPFInstruction struct {
+	Code uint16
+	Jt   uint8
+	Jf   uint8
+	K    uint32
+}
+
+// SetBPF installs classic BPF program as a packet filter of the
+// RingReader. The program is evaluated in C on every received packet
+// and only matching packets are exposed with Next() or NextBatch().
+// See SetFilter() for details on filtering.
+//
+// The program is copied so prog may be reused after the call. If
+// prog is empty, filtering is disabled.
+//
+// EINVAL is returned if the program may read outside of its scratch
+// memory, divides by constant zero, jumps out of the program or
+// doesn't end with a return instruction.
+func (rr *RingReader) SetBPF(prog []BPFInstruction) error {
+	var p *C.struct_bpf_filter_prog
+
+	if len(prog) > 0 {
+		var err error
+		if p, err = newBPFProg(prog); err != nil {
+			return err
+		}
+	}
+
+	C.ring_reader_set_bpf(rr.reader, p)
+	rr.setFilterMem(unsafe.Pointer(p))
+	return nil
+}
+
+// newBPFProg copies prog into C memory and validates it. The program
+// should be released with C.free().
+func newBPFProg(prog []BPFInstruction) (*C.struct_bpf_filter_prog, error) {
+	p := C.bpf_filter_alloc(C.int(len(prog)))
+	if p == nil {
+		return nil, syscall.ENOMEM
+	}
+
+	insns := (*[1 << 20]BPFInstruction)(bpfInsns(p))[:len(prog):len(prog)]
+	copy(insns, prog)
+
+	if err := retErr(C.bpf_filter_validate(p)); err != nil {
+		C.free(unsafe.Pointer(p))
+		return nil, err
+	}
+	return p, nil
+}
+
+// bpfInsns returns the address of instructions of the program.
+func bpfInsns(p *C.struct_bpf_filter_prog) unsafe.Pointer {
+	return unsafe.Pointer(uintptr(unsafe.Pointer(p)) + uintptr(C.BPF_FILTER_INSNS_OFF))
+}
+
+// runBPF validates prog and runs it on data as the filter installed
+// with SetBPF() would do.
+func runBPF(prog []BPFInstruction, data []byte) (uint32, error) {
+	p, err := newBPFProg(prog)
+	if err != nil {
+		return 0, err
+	}
+	defer C.free(unsafe.Pointer(p))
+
+	var ptr *C.uint8_t
+	if len(data) > 0 {
+		ptr = (*C.uint8_t)(unsafe.Pointer(&data[0]))
+	}
+	insns := (*C.struct_bpf_filter_insn)(bpfInsns(p))
+	return uint32(C.bpf_filter_run(insns, ptr, C.uint32_t(len(data)),
+		C.uint32_t(len(data)))), nil
+}
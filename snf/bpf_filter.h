@@ -0,0 +1,353 @@
+#ifndef _BPF_FILTER_H_
+#define _BPF_FILTER_H_
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "ring_reader.h"
+
+/*
+ * Classic BPF instruction, binary compatible with struct sock_filter
+ * and libpcap's struct bpf_insn.
+ */
+struct bpf_filter_insn {
+	uint16_t code;
+	uint8_t jt;
+	uint8_t jf;
+	uint32_t k;
+};
+
+struct bpf_filter_prog {
+	int len;
+	struct bpf_filter_insn insns[0];
+};
+
+enum {
+	BPF_FILTER_INSNS_OFF = offsetof(struct bpf_filter_prog, insns[0]),
+};
+
+#define RR_BPF_CLASS(code) ((code) & 0x07)
+#define RR_BPF_LD   0x00
+#define RR_BPF_LDX  0x01
+#define RR_BPF_ST   0x02
+#define RR_BPF_STX  0x03
+#define RR_BPF_ALU  0x04
+#define RR_BPF_JMP  0x05
+#define RR_BPF_RET  0x06
+#define RR_BPF_MISC 0x07
+
+#define RR_BPF_SIZE(code) ((code) & 0x18)
+#define RR_BPF_W 0x00
+#define RR_BPF_H 0x08
+#define RR_BPF_B 0x10
+
+#define RR_BPF_MODE(code) ((code) & 0xe0)
+#define RR_BPF_IMM 0x00
+#define RR_BPF_ABS 0x20
+#define RR_BPF_IND 0x40
+#define RR_BPF_MEM 0x60
+#define RR_BPF_LEN 0x80
+#define RR_BPF_MSH 0xa0
+
+#define RR_BPF_OP(code) ((code) & 0xf0)
+#define RR_BPF_ADD 0x00
+#define RR_BPF_SUB 0x10
+#define RR_BPF_MUL 0x20
+#define RR_BPF_DIV 0x30
+#define RR_BPF_OR  0x40
+#define RR_BPF_AND 0x50
+#define RR_BPF_LSH 0x60
+#define RR_BPF_RSH 0x70
+#define RR_BPF_NEG 0x80
+#define RR_BPF_MOD 0x90
+#define RR_BPF_XOR 0xa0
+
+#define RR_BPF_JA   0x00
+#define RR_BPF_JEQ  0x10
+#define RR_BPF_JGT  0x20
+#define RR_BPF_JGE  0x30
+#define RR_BPF_JSET 0x40
+
+#define RR_BPF_SRC(code) ((code) & 0x08)
+#define RR_BPF_K 0x00
+#define RR_BPF_X 0x08
+
+#define RR_BPF_RVAL(code) ((code) & 0x18)
+#define RR_BPF_A 0x10
+
+#define RR_BPF_MISCOP(code) ((code) & 0xf8)
+#define RR_BPF_TAX 0x00
+#define RR_BPF_TXA 0x80
+
+#define RR_BPF_MEMWORDS 16
+
+/*
+ * Allocate program of len instructions.
+ */
+static struct bpf_filter_prog *
+bpf_filter_alloc(int len)
+{
+	struct bpf_filter_prog *prog;
+	prog = malloc(sizeof(*prog) + len * sizeof(prog->insns[0]));
+	if (prog != NULL) {
+		prog->len = len;
+	}
+	return prog;
+}
+
+/*
+ * Check that program terminates and doesn't access memory out of
+ * bounds so it may be run with no runtime checks except for packet
+ * boundaries.
+ *
+ * 0 if program is valid.
+ * EINVAL otherwise.
+ */
+static int
+bpf_filter_validate(const struct bpf_filter_prog *prog)
+{
+	int i;
+
+	if (prog->len < 1 || RR_BPF_CLASS(prog->insns[prog->len - 1].code) != RR_BPF_RET) {
+		return EINVAL;
+	}
+
+	for (i = 0; i < prog->len; i++) {
+		const struct bpf_filter_insn *pc = &prog->insns[i];
+		uint32_t left = prog->len - i - 1;
+
+		switch (RR_BPF_CLASS(pc->code)) {
+		case RR_BPF_LD:
+		case RR_BPF_LDX:
+			if (RR_BPF_MODE(pc->code) == RR_BPF_MEM && pc->k >= RR_BPF_MEMWORDS) {
+				return EINVAL;
+			}
+			break;
+		case RR_BPF_ST:
+		case RR_BPF_STX:
+			if (pc->k >= RR_BPF_MEMWORDS) {
+				return EINVAL;
+			}
+			break;
+		case RR_BPF_ALU:
+			if ((RR_BPF_OP(pc->code) == RR_BPF_DIV || RR_BPF_OP(pc->code) == RR_BPF_MOD) &&
+					RR_BPF_SRC(pc->code) == RR_BPF_K && pc->k == 0) {
+				return EINVAL;
+			}
+			break;
+		case RR_BPF_JMP:
+			if (RR_BPF_OP(pc->code) == RR_BPF_JA) {
+				if (pc->k >= left) {
+					return EINVAL;
+				}
+			} else if (pc->jt >= left || pc->jf >= left) {
+				return EINVAL;
+			}
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Run validated program on packet p of buflen captured bytes and
+ * wirelen original bytes.
+ *
+ * Return non-0 if packet matches the filter.
+ */
+static uint32_t
+bpf_filter_run(const struct bpf_filter_insn *pc, const uint8_t *p,
+		uint32_t wirelen, uint32_t buflen)
+{
+	uint32_t A = 0, X = 0, k, v;
+	uint32_t mem[RR_BPF_MEMWORDS];
+
+	for (--pc;;) {
+		++pc;
+
+		switch (RR_BPF_CLASS(pc->code)) {
+		case RR_BPF_LD:
+		case RR_BPF_LDX:
+			switch (RR_BPF_MODE(pc->code)) {
+			case RR_BPF_IMM:
+				v = pc->k;
+				break;
+			case RR_BPF_LEN:
+				v = wirelen;
+				break;
+			case RR_BPF_MEM:
+				v = mem[pc->k];
+				break;
+			case RR_BPF_MSH:
+				if (pc->k >= buflen) {
+					return 0;
+				}
+				v = (p[pc->k] & 0xf) << 2;
+				break;
+			case RR_BPF_ABS:
+			case RR_BPF_IND:
+				k = pc->k;
+				if (RR_BPF_MODE(pc->code) == RR_BPF_IND) {
+					if (X > buflen || k > buflen - X) {
+						return 0;
+					}
+					k += X;
+				}
+				if (k > buflen) {
+					return 0;
+				}
+				switch (RR_BPF_SIZE(pc->code)) {
+				case RR_BPF_W:
+					if (buflen - k < 4) {
+						return 0;
+					}
+					v = (uint32_t)p[k] << 24 | (uint32_t)p[k + 1] << 16 |
+						(uint32_t)p[k + 2] << 8 | p[k + 3];
+					break;
+				case RR_BPF_H:
+					if (buflen - k < 2) {
+						return 0;
+					}
+					v = (uint32_t)p[k] << 8 | p[k + 1];
+					break;
+				case RR_BPF_B:
+					if (buflen - k < 1) {
+						return 0;
+					}
+					v = p[k];
+					break;
+				default:
+					return 0;
+				}
+				break;
+			default:
+				return 0;
+			}
+
+			if (RR_BPF_CLASS(pc->code) == RR_BPF_LD) {
+				A = v;
+			} else {
+				X = v;
+			}
+			break;
+
+		case RR_BPF_ST:
+			mem[pc->k] = A;
+			break;
+
+		case RR_BPF_STX:
+			mem[pc->k] = X;
+			break;
+
+		case RR_BPF_ALU:
+			v = RR_BPF_SRC(pc->code) == RR_BPF_X ? X : pc->k;
+			switch (RR_BPF_OP(pc->code)) {
+			case RR_BPF_ADD:
+				A += v;
+				break;
+			case RR_BPF_SUB:
+				A -= v;
+				break;
+			case RR_BPF_MUL:
+				A *= v;
+				break;
+			case RR_BPF_DIV:
+				if (v == 0) {
+					return 0;
+				}
+				A /= v;
+				break;
+			case RR_BPF_MOD:
+				if (v == 0) {
+					return 0;
+				}
+				A %= v;
+				break;
+			case RR_BPF_OR:
+				A |= v;
+				break;
+			case RR_BPF_AND:
+				A &= v;
+				break;
+			case RR_BPF_XOR:
+				A ^= v;
+				break;
+			case RR_BPF_LSH:
+				A = v < 32 ? A << v : 0;
+				break;
+			case RR_BPF_RSH:
+				A = v < 32 ? A >> v : 0;
+				break;
+			case RR_BPF_NEG:
+				A = -A;
+				break;
+			default:
+				return 0;
+			}
+			break;
+
+		case RR_BPF_JMP:
+			if (RR_BPF_OP(pc->code) == RR_BPF_JA) {
+				pc += pc->k;
+				break;
+			}
+
+			v = RR_BPF_SRC(pc->code) == RR_BPF_X ? X : pc->k;
+			switch (RR_BPF_OP(pc->code)) {
+			case RR_BPF_JEQ:
+				pc += (A == v) ? pc->jt : pc->jf;
+				break;
+			case RR_BPF_JGT:
+				pc += (A > v) ? pc->jt : pc->jf;
+				break;
+			case RR_BPF_JGE:
+				pc += (A >= v) ? pc->jt : pc->jf;
+				break;
+			case RR_BPF_JSET:
+				pc += (A & v) ? pc->jt : pc->jf;
+				break;
+			default:
+				return 0;
+			}
+			break;
+
+		case RR_BPF_RET:
+			return RR_BPF_RVAL(pc->code) == RR_BPF_A ? A : pc->k;
+
+		case RR_BPF_MISC:
+			if (RR_BPF_MISCOP(pc->code) == RR_BPF_TAX) {
+				X = A;
+			} else {
+				A = X;
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * ring_reader_filter_fn implementation with ctx pointing to
+ * bpf_filter_prog.
+ */
+static int
+bpf_filter_req(struct snf_recv_req *req, void *ctx)
+{
+	struct bpf_filter_prog *prog = ctx;
+	return bpf_filter_run(prog->insns, req->pkt_addr, req->length, req->length) != 0;
+}
+
+/*
+ * Install BPF program as a filter for the reader. If prog is NULL,
+ * filtering is disabled.
+ */
+static void
+ring_reader_set_bpf(struct ring_reader *reader, struct bpf_filter_prog *prog)
+{
+	reader->filter = prog != NULL ? bpf_filter_req : NULL;
+	reader->filter_ctx = prog;
+}
+
+#endif /* _BPF_FILTER_H_ */
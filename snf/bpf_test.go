@@ -0,0 +1,201 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"syscall"
+	"testing"
+)
+
+// bpfUDPPort returns program of 'tcpdump -dd udp port <port>'.
+func bpfUDPPort(port uint32) []BPFInstruction {
+	return []BPFInstruction{
+		{0x28, 0, 0, 0x0000000c},
+		{0x15, 0, 6, 0x000086dd},
+		{0x30, 0, 0, 0x00000014},
+		{0x15, 0, 15, 0x00000011},
+		{0x28, 0, 0, 0x00000036},
+		{0x15, 12, 0, port},
+		{0x28, 0, 0, 0x00000038},
+		{0x15, 10, 11, port},
+		{0x15, 0, 10, 0x00000800},
+		{0x30, 0, 0, 0x00000017},
+		{0x15, 0, 8, 0x00000011},
+		{0x28, 0, 0, 0x00000014},
+		{0x45, 6, 0, 0x00001fff},
+		{0xb1, 0, 0, 0x0000000e},
+		{0x48, 0, 0, 0x0000000e},
+		{0x15, 2, 0, port},
+		{0x48, 0, 0, 0x00000010},
+		{0x15, 0, 1, port},
+		{0x06, 0, 0, 0x00040000},
+		{0x06, 0, 0, 0x00000000},
+	}
+}
+
+// udpFrame crafts Ethernet/IPv4/UDP frame with specified protocol,
+// ports and IPv4 header length in 32-bit words.
+func udpFrame(proto byte, ihl int, sport, dport uint16) []byte {
+	be := binary.BigEndian
+	data := make([]byte, 14+ihl*4+8+16)
+	be.PutUint16(data[12:], 0x0800)
+
+	ip := data[14:]
+	ip[0] = 0x40 | byte(ihl)
+	be.PutUint16(ip[2:], uint16(len(ip)))
+	ip[8] = 64
+	ip[9] = proto
+
+	udp := ip[ihl*4:]
+	be.PutUint16(udp[0:], sport)
+	be.PutUint16(udp[2:], dport)
+	be.PutUint16(udp[4:], uint16(len(udp)))
+	return data
+}
+
+func TestBPFValidate(t *testing.T) {
+	ret := BPFInstruction{Code: 0x06, K: 1}
+	progs := map[string][]BPFInstruction{
+		"empty":          {},
+		"no ret":         {{Code: 0x00, K: 1}},
+		"ret not last":   {ret, {Code: 0x00, K: 1}},
+		"ja out":         {{Code: 0x05, K: 1}, ret},
+		"jt out":         {{Code: 0x15, Jt: 1}, ret},
+		"jf out":         {{Code: 0x15, Jf: 1}, ret},
+		"jt past end":    {{Code: 0x15, Jt: 2}, ret, ret},
+		"ld mem out":     {{Code: 0x60, K: 16}, ret},
+		"ldx mem out":    {{Code: 0x61, K: 16}, ret},
+		"st out":         {{Code: 0x02, K: 16}, ret},
+		"stx out":        {{Code: 0x03, K: 16}, ret},
+		"div by 0":       {{Code: 0x34, K: 0}, ret},
+		"mod by 0":       {{Code: 0x94, K: 0}, ret},
+		"ret only valid": {ret},
+	}
+
+	for name, prog := range progs {
+		_, err := runBPF(prog, nil)
+		if name == "ret only valid" {
+			if err != nil {
+				t.Errorf("%s: %v", name, err)
+			}
+		} else if err != syscall.EINVAL {
+			t.Errorf("%s: expected EINVAL, got %v", name, err)
+		}
+	}
+
+	// jumps to the last instruction
+	for _, prog := range [][]BPFInstruction{
+		{{Code: 0x05, K: 1}, ret, ret},
+		{{Code: 0x15, Jt: 1, Jf: 0}, ret, ret},
+		{{Code: 0x54, K: 0}, {Code: 0x02, K: 15}, ret},
+	} {
+		if _, err := runBPF(prog, nil); err != nil {
+			t.Errorf("%v: %v", prog, err)
+		}
+	}
+}
+
+func TestBPFRunBounds(t *testing.T) {
+	data := udpFrame(17, 5, 1000, 2000)
+	n := uint32(len(data))
+	accept := BPFInstruction{Code: 0x06, K: 1}
+
+	tests := []struct {
+		name string
+		prog []BPFInstruction
+		want uint32
+	}{
+		{"ldb last", []BPFInstruction{{Code: 0x30, K: n - 1}, accept}, 1},
+		{"ldb out", []BPFInstruction{{Code: 0x30, K: n}, accept}, 0},
+		{"ldh last", []BPFInstruction{{Code: 0x28, K: n - 2}, accept}, 1},
+		{"ldh out", []BPFInstruction{{Code: 0x28, K: n - 1}, accept}, 0},
+		{"ld last", []BPFInstruction{{Code: 0x20, K: n - 4}, accept}, 1},
+		{"ld out", []BPFInstruction{{Code: 0x20, K: n - 3}, accept}, 0},
+		{"ld far out", []BPFInstruction{{Code: 0x20, K: 0xfffffffe}, accept}, 0},
+		{"ldh ind out", []BPFInstruction{
+			{Code: 0x01, K: n - 1}, // ldx #n-1
+			{Code: 0x48, K: 0},     // ldh [x+0]
+			accept}, 0},
+		{"ldh ind wrap", []BPFInstruction{
+			{Code: 0x01, K: 0xffffffff}, // ldx #-1
+			{Code: 0x48, K: 2},          // ldh [x+2]
+			accept}, 0},
+		{"ldxb msh out", []BPFInstruction{{Code: 0xb1, K: n}, accept}, 0},
+		{"len", []BPFInstruction{{Code: 0x80}, {Code: 0x16}}, n},
+	}
+
+	for _, test := range tests {
+		if got, err := runBPF(test.prog, data); err != nil {
+			t.Errorf("%s: %v", test.name, err)
+		} else if got != test.want {
+			t.Errorf("%s: expected %d, got %d", test.name, test.want, got)
+		}
+	}
+
+	// ret #1 on empty packet only if nothing is loaded
+	if got, _ := runBPF([]BPFInstruction{{Code: 0x30}, accept}, nil); got != 0 {
+		t.Errorf("empty packet: expected 0, got %d", got)
+	}
+}
+
+func TestBPFRunDivByZero(t *testing.T) {
+	accept := BPFInstruction{Code: 0x06, K: 1}
+	for _, code := range []uint16{0x3c, 0x9c} { // div x, mod x
+		prog := []BPFInstruction{
+			{Code: 0x00, K: 100}, // ld #100
+			{Code: 0x01, K: 0},   // ldx #0
+			{Code: code},
+			accept,
+		}
+		if got, err := runBPF(prog, nil); err != nil || got != 0 {
+			t.Errorf("%#x: expected 0, got %d, %v", code, got, err)
+		}
+
+		prog[1].K = 7
+		prog[3] = BPFInstruction{Code: 0x16} // ret a
+		want := map[uint16]uint32{0x3c: 100 / 7, 0x9c: 100 % 7}[code]
+		if got, err := runBPF(prog, nil); err != nil || got != want {
+			t.Errorf("%#x: expected %d, got %d, %v", code, want, got, err)
+		}
+	}
+}
+
+func TestBPFRunUDPPort(t *testing.T) {
+	prog := bpfUDPPort(1234)
+
+	tests := []struct {
+		name string
+		data []byte
+		want bool
+	}{
+		{"dport", udpFrame(17, 5, 1000, 1234), true},
+		{"sport", udpFrame(17, 5, 1234, 1000), true},
+		{"ip options", udpFrame(17, 7, 1000, 1234), true},
+		{"other ports", udpFrame(17, 5, 1000, 1235), false},
+		{"tcp", udpFrame(6, 5, 1000, 1234), false},
+		{"truncated", udpFrame(17, 5, 1000, 1234)[:36], false},
+	}
+
+	frag := udpFrame(17, 5, 1000, 1234)
+	binary.BigEndian.PutUint16(frag[20:], 0x0001) // fragment offset
+	tests = append(tests, struct {
+		name string
+		data []byte
+		want bool
+	}{"fragment", frag, false})
+
+	for _, test := range tests {
+		got, err := runBPF(prog, test.data)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if (got != 0) != test.want {
+			t.Errorf("%s: expected %v, got %d", test.name, test.want, got)
+		}
+	}
+}
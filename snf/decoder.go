@@ -0,0 +1,85 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+)
+
+// Decoder decodes packet headers into preallocated layers with
+// gopacket.DecodingLayerParser so that decoding involves no heap
+// allocations per packet.
+//
+// The layers and CaptureInfo are overwritten by every call to
+// Decode(), make a copy if you want to retain them. Decoding stops at
+// the first layer not supported by the Decoder, e.g. ARP, ICMP or
+// IPv6 extension headers, with no error and the rest of the packet is
+// left undecoded. Payload is only filled after TCP or UDP.
+type Decoder struct {
+	Ethernet layers.Ethernet
+	Dot1Q    layers.Dot1Q
+	IPv4     layers.IPv4
+	IPv6     layers.IPv6
+	TCP      layers.TCP
+	UDP      layers.UDP
+	Payload  gopacket.Payload
+
+	// Metadata of the last decoded packet.
+	CaptureInfo gopacket.CaptureInfo
+
+	// Types of layers decoded from the last packet.
+	Decoded []gopacket.LayerType
+
+	parser *gopacket.DecodingLayerParser
+}
+
+// NewDecoder creates Decoder of Ethernet frames.
+func NewDecoder() *Decoder {
+	d := &Decoder{Decoded: make([]gopacket.LayerType, 0, 8)}
+	d.parser = gopacket.NewDecodingLayerParser(layers.LayerTypeEthernet,
+		&d.Ethernet, &d.Dot1Q, &d.IPv4, &d.IPv6, &d.TCP, &d.UDP,
+		&d.Payload)
+	d.parser.IgnoreUnsupported = true
+	return d
+}
+
+// Decode fills CaptureInfo and decodes layers of the packet. Error
+// is returned if a layer failed to decode, in which case Decoded
+// holds successfully decoded layers preceding the failed one.
+func (d *Decoder) Decode(req *RecvReq) error {
+	req.FillCaptureInfo(&d.CaptureInfo)
+	return d.parser.DecodeLayers(req.Data(), &d.Decoded)
+}
+
+// Has reports if the layer of type t was decoded from the last packet.
+func (d *Decoder) Has(t gopacket.LayerType) bool {
+	for _, l := range d.Decoded {
+		if l == t {
+			return true
+		}
+	}
+	return false
+}
+
+// Decode decodes the current packet with Decoder owned by RingReader.
+// It is allocated on the first call. See Decoder's Decode().
+//
+// The common pattern is:
+//
+//	for rr.LoopNext() {
+//		d, err := rr.Decode()
+//		if err == nil && d.Has(layers.LayerTypeTCP) {
+//			// process d.IPv4, d.TCP etc.
+//		}
+//	}
+func (rr *RingReader) Decode() (*Decoder, error) {
+	if rr.dec == nil {
+		rr.dec = NewDecoder()
+	}
+	return rr.dec, rr.dec.Decode(rr.req())
+}
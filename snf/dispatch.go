@@ -0,0 +1,329 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"runtime"
+	"sync/atomic"
+	"syscall"
+)
+
+// KeyFunc returns a key of the packet by which it is assigned to a
+// consumer of a DispatchGroup.
+type KeyFunc func(req *RecvReq) uint32
+
+// KeyHwHash returns the hash calculated by the NIC.
+func KeyHwHash(req *RecvReq) uint32 {
+	return req.HwHash()
+}
+
+// KeyPortNum returns the port number the packet was received on.
+func KeyPortNum(req *RecvReq) uint32 {
+	return uint32(req.PortNum())
+}
+
+// KeyL4Ports returns a symmetric key of TCP, UDP or SCTP ports of the
+// packet so that both directions of a flow get the same key. VLAN
+// tags are skipped, IPv6 extension headers are not. 0 is returned
+// for other packets and all IPv4 fragments, so fragments of a
+// datagram are kept together.
+func KeyL4Ports(req *RecvReq) uint32 {
+	data := req.Data()
+	be := binary.BigEndian
+
+	off := 12
+	for off+2 <= len(data) {
+		if t := be.Uint16(data[off:]); t != 0x8100 && t != 0x88a8 {
+			break
+		}
+		off += 4
+	}
+	if off+2 > len(data) {
+		return 0
+	}
+
+	var proto byte
+	switch be.Uint16(data[off:]) {
+	case 0x0800:
+		off += 2
+		if off+20 > len(data) || (data[off+6]&0x3f)|data[off+7] != 0 {
+			return 0
+		}
+		proto = data[off+9]
+		off += int(data[off]&0xf) * 4
+	case 0x86dd:
+		off += 2
+		if off+40 > len(data) {
+			return 0
+		}
+		proto = data[off+6]
+		off += 40
+	default:
+		return 0
+	}
+
+	if (proto != 6 && proto != 17 && proto != 132) || off+4 > len(data) {
+		return 0
+	}
+	src, dst := be.Uint16(data[off:]), be.Uint16(data[off+2:])
+	return uint32(src ^ dst)
+}
+
+// DispatchGroup describes a group of consumers of Dispatcher. Every
+// packet matching the group is delivered to one of its consumers
+// chosen by the packet's key.
+type DispatchGroup struct {
+	// Consumers is the number of consumers in the group.
+	Consumers int
+
+	// QueueSize is the capacity of every consumer's queue. It is
+	// rounded up to a power of 2. Default is 1024.
+	QueueSize int
+
+	// Key selects the consumer of the packet as Key(req) %
+	// Consumers. Default is KeyHwHash.
+	Key KeyFunc
+
+	// Match, if not nil, selects packets delivered to the group.
+	Match func(req *RecvReq) bool
+
+	// Lossy specifies that packets are dropped if the consumer's
+	// queue is full. Otherwise, Dispatcher waits for the consumer,
+	// stalling the other groups.
+	Lossy bool
+}
+
+// DispatchQueue is a lock-free single-producer/single-consumer queue
+// of packets of a consumer of Dispatcher.
+type DispatchQueue struct {
+	mask  uint64
+	slots []HandOffReq
+
+	_    [64]byte
+	head uint64 // written by Dispatcher
+	_    [56]byte
+	tail uint64 // written by consumer
+	_    [56]byte
+
+	closed uint32
+	drops  uint64
+}
+
+func newDispatchQueue(size int) *DispatchQueue {
+	n := 1
+	for n < size {
+		n <<= 1
+	}
+	return &DispatchQueue{
+		mask:  uint64(n - 1),
+		slots: make([]HandOffReq, n),
+	}
+}
+
+func (q *DispatchQueue) push(req HandOffReq) bool {
+	head := q.head
+	if head-atomic.LoadUint64(&q.tail) > q.mask {
+		return false
+	}
+	q.slots[head&q.mask] = req
+	atomic.StoreUint64(&q.head, head+1)
+	return true
+}
+
+// TryGet retrieves next packet without blocking. If false is
+// returned, the queue is empty. The packet should be released with
+// Release() once processed.
+//
+// DispatchQueue should be consumed by a single goroutine.
+func (q *DispatchQueue) TryGet() (HandOffReq, bool) {
+	tail := q.tail
+	if tail >= atomic.LoadUint64(&q.head) {
+		return HandOffReq{}, false
+	}
+
+	req := q.slots[tail&q.mask]
+	atomic.StoreUint64(&q.tail, tail+1)
+	return req, true
+}
+
+// Get retrieves next packet. It spins until a packet is available or
+// Dispatcher is stopped in which case false is returned.
+func (q *DispatchQueue) Get() (HandOffReq, bool) {
+	for {
+		if req, ok := q.TryGet(); ok {
+			return req, true
+		}
+
+		if atomic.LoadUint32(&q.closed) != 0 {
+			return q.TryGet()
+		}
+
+		runtime.Gosched()
+	}
+}
+
+// Len returns the number of queued packets.
+func (q *DispatchQueue) Len() int {
+	return int(atomic.LoadUint64(&q.head) - atomic.LoadUint64(&q.tail))
+}
+
+// Drops returns the number of packets dropped because the queue was
+// full, see DispatchGroup's Lossy.
+func (q *DispatchQueue) Drops() uint64 {
+	return atomic.LoadUint64(&q.drops)
+}
+
+type dispatchGroup struct {
+	DispatchGroup
+	queues []*DispatchQueue
+}
+
+type dispatchTarget struct {
+	q     *DispatchQueue
+	lossy bool
+}
+
+// Dispatcher redistributes packets received by HandOff producers
+// to groups of consumers by user-defined keys, independently of the
+// number of hardware rings and RSS settings. Packet data is not
+// copied: consumers get HandOffReq descriptors and packet memory is
+// returned to the ring once all the groups the packet was delivered
+// to release it.
+//
+// Please note that packet memory is returned to SNF in FIFO order, so
+// a slow consumer holds ring memory of the packets received after its
+// oldest queued packet up to the HandOff size, see HandOff.
+type Dispatcher struct {
+	sources []*HandOff
+	groups  []dispatchGroup
+	targets []dispatchTarget
+	stopped uint32
+}
+
+// NewDispatcher creates Dispatcher reading from sources. Dispatcher
+// becomes the producer of all the sources so they should have 0
+// timeout unless there is a single source.
+func NewDispatcher(sources ...*HandOff) *Dispatcher {
+	return &Dispatcher{sources: sources}
+}
+
+// AddGroup adds a group of consumers and returns its id. Groups should
+// be added before Run().
+func (d *Dispatcher) AddGroup(g DispatchGroup) int {
+	if g.Consumers <= 0 {
+		g.Consumers = 1
+	}
+	if g.QueueSize <= 0 {
+		g.QueueSize = 1024
+	}
+	if g.Key == nil {
+		g.Key = KeyHwHash
+	}
+
+	dg := dispatchGroup{DispatchGroup: g}
+	for i := 0; i < g.Consumers; i++ {
+		dg.queues = append(dg.queues, newDispatchQueue(g.QueueSize))
+	}
+
+	d.groups = append(d.groups, dg)
+	d.targets = make([]dispatchTarget, 0, len(d.groups))
+	return len(d.groups) - 1
+}
+
+// Queue returns the queue of i-th consumer of the group.
+func (d *Dispatcher) Queue(group, i int) *DispatchQueue {
+	return d.groups[group].queues[i]
+}
+
+// dispatch delivers the packet to matching groups.
+func (d *Dispatcher) dispatch(req HandOffReq) {
+	r := req.RecvReq()
+	targets := d.targets[:0]
+	for i := range d.groups {
+		g := &d.groups[i]
+		if g.Match == nil || g.Match(r) {
+			q := g.queues[g.Key(r)%uint32(len(g.queues))]
+			targets = append(targets, dispatchTarget{q, g.Lossy})
+		}
+	}
+
+	if len(targets) == 0 {
+		req.Release()
+		return
+	}
+
+	// the producer holds a single reference
+	if n := len(targets) - 1; n > 0 {
+		req.retain(int32(n))
+	}
+
+	for _, t := range targets {
+		for !t.q.push(req) {
+			if t.lossy || atomic.LoadUint32(&d.stopped) != 0 {
+				atomic.AddUint64(&t.q.drops, 1)
+				req.Release()
+				break
+			}
+			runtime.Gosched()
+		}
+	}
+}
+
+// Poll produces packets on every source once and dispatches them. It
+// returns the number of dispatched packets and the first error other
+// than EAGAIN.
+func (d *Dispatcher) Poll() (n int, err error) {
+	for _, h := range d.sources {
+		if _, err = h.Produce(); err != nil && err != syscall.EAGAIN {
+			return n, err
+		}
+		err = nil
+
+		for req, ok := h.TryGet(); ok; req, ok = h.TryGet() {
+			d.dispatch(req)
+			n++
+		}
+	}
+	return n, nil
+}
+
+// Run dispatches packets until Stop() is called or an error other
+// than EAGAIN is encountered on any of the sources. Once Run()
+// returns, the sources and consumer queues are closed so consumers'
+// Get() returns false after all queued packets are consumed. Run
+// should be called from a single goroutine.
+func (d *Dispatcher) Run() error {
+	defer d.close()
+
+	for atomic.LoadUint32(&d.stopped) == 0 {
+		n, err := d.Poll()
+		if err != nil {
+			return err
+		}
+		if n == 0 {
+			runtime.Gosched()
+		}
+	}
+	return nil
+}
+
+// Stop signals Run() to return.
+func (d *Dispatcher) Stop() {
+	atomic.StoreUint32(&d.stopped, 1)
+}
+
+func (d *Dispatcher) close() {
+	for _, h := range d.sources {
+		h.Close()
+	}
+	for i := range d.groups {
+		for _, q := range d.groups[i].queues {
+			atomic.StoreUint32(&q.closed, 1)
+		}
+	}
+}
@@ -0,0 +1,146 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"encoding/binary"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+// drain releases all queued packets and returns their number.
+func drain(q *snf.DispatchQueue) (n int) {
+	for req, ok := q.TryGet(); ok; req, ok = q.TryGet() {
+		req.Release()
+		n++
+	}
+	return
+}
+
+func TestDispatcherRefs(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	r, teardown := mockupRing(t, "2", "64")
+	defer teardown()
+
+	h := snf.NewHandOff(r, 0, 16)
+	d := snf.NewDispatcher(h)
+	all := d.AddGroup(snf.DispatchGroup{Consumers: 2, QueueSize: 16})
+	lossy := d.AddGroup(snf.DispatchGroup{QueueSize: 1, Lossy: true})
+	none := d.AddGroup(snf.DispatchGroup{
+		Match: func(*snf.RecvReq) bool { return false },
+	})
+
+	n, err := d.Poll()
+	assertFail(n == 16 && err == nil, n, err)
+	assertFail(d.Queue(all, 0).Len()+d.Queue(all, 1).Len() == 16)
+	assertFail(d.Queue(lossy, 0).Len() == 1 && d.Queue(lossy, 0).Drops() == 15)
+	assertFail(d.Queue(none, 0).Len() == 0)
+
+	// the packet queued to the lossy group holds the ring
+	assertFail(drain(d.Queue(all, 0))+drain(d.Queue(all, 1)) == 16)
+	n, err = d.Poll()
+	assertFail(n == 0 && err == nil, n, err)
+	assertFail(h.Outstanding() == 16, h.Outstanding())
+
+	assertFail(drain(d.Queue(lossy, 0)) == 1)
+	n, err = d.Poll()
+	assertFail(n == 16 && err == nil, n, err)
+	assertFail(d.Queue(lossy, 0).Drops() == 30, d.Queue(lossy, 0).Drops())
+
+	// and so does the lossless group
+	assertFail(drain(d.Queue(lossy, 0)) == 1)
+	n, err = d.Poll()
+	assertFail(n == 0 && err == nil, n, err)
+
+	assertFail(drain(d.Queue(all, 0))+drain(d.Queue(all, 1)) == 16)
+	n, err = d.Poll()
+	assertFail(n == 16 && err == nil, n, err)
+}
+
+func TestDispatcherRun(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	r, teardown := mockupRing(t, "2", "64")
+	defer teardown()
+
+	groups := []snf.DispatchGroup{
+		{Consumers: 3, Key: snf.KeyL4Ports},
+		{Consumers: 2, QueueSize: 16, Lossy: true},
+	}
+	d := snf.NewDispatcher(snf.NewHandOff(r, 0, 1024))
+
+	var wg sync.WaitGroup
+	counts := make([][]uint64, len(groups))
+	for _, g := range groups {
+		id := d.AddGroup(g)
+		counts[id] = make([]uint64, g.Consumers)
+		for i := range counts[id] {
+			wg.Add(1)
+			go func(q *snf.DispatchQueue, n *uint64) {
+				defer wg.Done()
+				for req, ok := q.Get(); ok; req, ok = q.Get() {
+					req.Release()
+					atomic.AddUint64(n, 1)
+				}
+			}(d.Queue(id, i), &counts[id][i])
+		}
+	}
+
+	total := func(id int) (n uint64) {
+		for i := range counts[id] {
+			n += atomic.LoadUint64(&counts[id][i]) + d.Queue(id, i).Drops()
+		}
+		return
+	}
+
+	errCh := make(chan error)
+	go func() { errCh <- d.Run() }()
+
+	// go around the data ring several times
+	for total(0) < 4*mockupRingPkts {
+		runtime.Gosched()
+	}
+	d.Stop()
+	assertFail(<-errCh == nil)
+	wg.Wait()
+
+	// every packet is either consumed or dropped in every group
+	assertFail(total(0) == total(1), total(0), total(1))
+}
+
+func TestKeyL4Ports(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	rr, teardown := mockupReader(t, "2", "64", time.Second, 1)
+	defer teardown()
+
+	// synthetic packets are Ethernet/IPv4/UDP
+	assertFail(rr.Next(), rr.Err())
+	req := rr.RecvReq()
+	data := req.Data()
+	sport, dport := data[34:36], data[36:38]
+	key := snf.KeyL4Ports(req)
+	assertFail(key != 0 && key == uint32(binary.BigEndian.Uint16(sport)^binary.BigEndian.Uint16(dport)), key)
+
+	// both directions of a flow
+	sport[0], sport[1], dport[0], dport[1] = dport[0], dport[1], sport[0], sport[1]
+	assertFail(snf.KeyL4Ports(req) == key)
+
+	// first, middle and last fragments
+	for _, frag := range [][2]byte{{0x20, 0}, {0x20, 0xb9}, {0, 0xb9}} {
+		data[20], data[21] = frag[0], frag[1]
+		assertFail(snf.KeyL4Ports(req) == 0, frag)
+	}
+}
@@ -0,0 +1,192 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+#include "flow_table.h"
+*/
+import "C"
+
+import (
+	"encoding/binary"
+	"net"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// FlowRecord is a record of a flow exported from FlowTable.
+type FlowRecord C.struct_flow_record
+
+// Hash returns hash calculated by the NIC for the flow.
+func (r *FlowRecord) Hash() uint32 {
+	return uint32(r.hash)
+}
+
+// PortNum returns origin port number of the flow's first packet.
+func (r *FlowRecord) PortNum() int {
+	return int(r.portnum)
+}
+
+// Pkts returns number of packets of the flow.
+func (r *FlowRecord) Pkts() uint64 {
+	return uint64(r.pkts)
+}
+
+// Bytes returns number of bytes of the flow.
+func (r *FlowRecord) Bytes() uint64 {
+	return uint64(r.bytes)
+}
+
+// First returns timestamp of the first packet of the flow in
+// nanoseconds.
+func (r *FlowRecord) First() int64 {
+	return int64(r.first)
+}
+
+// Last returns timestamp of the last packet of the flow in
+// nanoseconds.
+func (r *FlowRecord) Last() int64 {
+	return int64(r.last)
+}
+
+func (r *FlowRecord) key() []byte {
+	return (*[36]byte)(unsafe.Pointer(&r.tuple[0]))[:r.tuple_len]
+}
+
+func (r *FlowRecord) addrLen() int {
+	switch r.tuple_len {
+	case 8, 12:
+		return net.IPv4len
+	case 32, 36:
+		return net.IPv6len
+	}
+	return 0
+}
+
+// SrcIP returns source IP address of the flow's first packet, or nil
+// if it wasn't an IP packet.
+func (r *FlowRecord) SrcIP() net.IP {
+	n := r.addrLen()
+	if n == 0 {
+		return nil
+	}
+	return append(net.IP(nil), r.key()[:n]...)
+}
+
+// DstIP returns destination IP address of the flow's first packet, or
+// nil if it wasn't an IP packet.
+func (r *FlowRecord) DstIP() net.IP {
+	n := r.addrLen()
+	if n == 0 {
+		return nil
+	}
+	return append(net.IP(nil), r.key()[n:2*n]...)
+}
+
+// Ports returns TCP, UDP or SCTP ports of the flow's first packet.
+// ok is false if the packet had no ports.
+func (r *FlowRecord) Ports() (src, dst uint16, ok bool) {
+	t := r.key()
+	if n := 2 * r.addrLen(); n > 0 && len(t) == n+4 {
+		return binary.BigEndian.Uint16(t[n:]), binary.BigEndian.Uint16(t[n+2:]), true
+	}
+	return 0, 0, false
+}
+
+// FlowTable accounts packets per flow in an open-addressed table
+// indexed by hash calculated by the NIC. The table is supposed to be
+// updated by a single RingReader since RSS keeps packets of a flow on
+// the same ring, so no locking is involved.
+//
+// Flows with the same hash are accounted as a single flow. The key of
+// a flow, i.e. IP addresses and ports, is taken from its first packet.
+type FlowTable struct {
+	t    *C.struct_flow_table
+	recs []FlowRecord
+}
+
+// NewFlowTable allocates FlowTable with at least size entries. flags
+// may specify RssHashInner to key VXLAN and GTP-U flows by inner
+// headers.
+//
+// FlowTable should be freed with Free() once it is detached from
+// the reader. EINVAL is returned if size exceeds 1<<31.
+func NewFlowTable(size int, flags int) (*FlowTable, error) {
+	if uint64(size) > 1<<31 {
+		return nil, syscall.EINVAL
+	}
+
+	n := 1
+	for n < size {
+		n <<= 1
+	}
+
+	t := C.flow_table_alloc(C.uint32_t(n), C.int(flags))
+	if t == nil {
+		return nil, syscall.ENOMEM
+	}
+
+	return &FlowTable{t: t, recs: make([]FlowRecord, 64)}, nil
+}
+
+// Free releases memory of FlowTable.
+func (ft *FlowTable) Free() {
+	C.free(unsafe.Pointer(ft.t))
+	ft.t = nil
+}
+
+// Flows returns the number of active flows.
+func (ft *FlowTable) Flows() int {
+	return int(ft.t.flows)
+}
+
+// Missed returns the number of packets not accounted since their flows
+// didn't fit into the table.
+func (ft *FlowTable) Missed() uint64 {
+	return uint64(ft.t.missed)
+}
+
+// Expire exports flows into fn as of now, a timestamp in
+// nanoseconds. Flows without packets for idle are exported and
+// deleted. Flows lasting for at least active are exported and their
+// counters are restarted, active of 0 disables that. Zero idle
+// exports and deletes all flows.
+//
+// FlowRecord passed to fn is only valid during the call. Expire should
+// be called from the goroutine reading packets with the RingReader
+// the table is attached to, e.g. every second between bursts.
+//
+// Returns the number of exported flows.
+func (ft *FlowTable) Expire(now int64, idle, active time.Duration, fn func(*FlowRecord)) (n int) {
+	for {
+		k := int(C.flow_table_expire(ft.t, C.uint64_t(now),
+			C.uint64_t(idle.Nanoseconds()), C.uint64_t(active.Nanoseconds()),
+			(*C.struct_flow_record)(&ft.recs[0]), C.int(len(ft.recs))))
+
+		for i := 0; i < k; i++ {
+			fn(&ft.recs[i])
+		}
+
+		if n += k; k < len(ft.recs) {
+			return
+		}
+	}
+}
+
+// SetFlowTable attaches FlowTable to the reader so that every packet
+// delivered to the user, i.e. passed the filter, is accounted in the
+// table. Nil detaches the table.
+func (rr *RingReader) SetFlowTable(ft *FlowTable) {
+	var t *C.struct_flow_table
+	if ft != nil {
+		t = ft.t
+	}
+	C.ring_reader_set_flows(rr.reader, t)
+	rr.flows = ft
+}
@@ -0,0 +1,218 @@
+#ifndef _FLOW_TABLE_H_
+#define _FLOW_TABLE_H_
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ring_reader.h"
+#include "rss_hash.h"
+
+/*
+ * Maximum number of slots probed for a flow.
+ */
+#define FLOW_TABLE_PROBES 16
+
+enum {
+	FLOW_EMPTY = 0,
+	FLOW_USED,
+	FLOW_DELETED,
+};
+
+/*
+ * Flow entry occupies two cache lines. The first one holds counters
+ * updated on every packet, the second one holds flow key which is
+ * written once upon flow creation.
+ */
+struct flow_entry {
+	uint32_t hash; // hw_hash of the flow
+	uint32_t state;
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t first; // timestamp of the first packet
+	uint64_t last; // timestamp of the last packet
+
+	uint8_t tuple[36] __attribute__((aligned(64)));
+	uint8_t tuple_len;
+	uint8_t portnum;
+} __attribute__((aligned(64)));
+
+/*
+ * Exported flow record.
+ */
+struct flow_record {
+	uint32_t hash;
+	uint8_t tuple[36];
+	uint8_t tuple_len;
+	uint8_t portnum;
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t first;
+	uint64_t last;
+};
+
+/*
+ * Open-addressed table of flows indexed by hw_hash. Flows with the
+ * same hw_hash are accounted as a single flow.
+ */
+struct flow_table {
+	uint32_t mask; // number of entries - 1
+	int flags; // RSS_HASH_* flags for flow key parsing
+	uint64_t flows; // active flows
+	uint64_t missed; // packets of flows which didn't fit
+	uint32_t cursor; // position of the interrupted export
+	struct flow_entry entries[0];
+};
+
+enum {
+	FLOW_TABLE_ENTRIES_OFF = offsetof(struct flow_table, entries[0]),
+};
+
+/*
+ * Allocate table of size entries which should be power of 2.
+ */
+static struct flow_table *
+flow_table_alloc(uint32_t size, int flags)
+{
+	struct flow_table *t;
+	size_t sz = sizeof(*t) + (size_t)size * sizeof(t->entries[0]);
+
+	if (posix_memalign((void **)&t, 64, sz) != 0) {
+		return NULL;
+	}
+
+	memset(t, 0, sz);
+	t->mask = size - 1;
+	t->flags = flags;
+	return t;
+}
+
+static struct flow_entry *
+flow_table_lookup(struct flow_table *t, const struct snf_recv_req *req)
+{
+	struct flow_entry *e, *free = NULL;
+	uint32_t i, hash = req->hw_hash;
+
+	for (i = 0; i < FLOW_TABLE_PROBES; i++) {
+		e = &t->entries[(hash + i) & t->mask];
+		if (e->state == FLOW_USED) {
+			if (e->hash == hash) {
+				return e;
+			}
+		} else if (free == NULL) {
+			free = e;
+			if (e->state == FLOW_EMPTY) {
+				break;
+			}
+		} else if (e->state == FLOW_EMPTY) {
+			break;
+		}
+	}
+
+	if ((e = free) == NULL) {
+		return NULL;
+	}
+
+	e->hash = hash;
+	e->state = FLOW_USED;
+	e->pkts = 0;
+	e->bytes = 0;
+	e->first = req->timestamp;
+	e->portnum = req->portnum;
+	e->tuple_len = rss_hash_parse_eth(req->pkt_addr, req->length,
+			t->flags | RSS_HASH_L4, e->tuple, 0);
+	t->flows++;
+	return e;
+}
+
+/*
+ * ring_reader_burst_fn implementation accounting packets in the flow
+ * table ctx.
+ */
+static void
+flow_table_update(struct snf_recv_req *reqs, int n, void *ctx)
+{
+	struct flow_table *t = ctx;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		struct flow_entry *e = flow_table_lookup(t, &reqs[i]);
+
+		if (e == NULL) {
+			t->missed++;
+			continue;
+		}
+
+		e->pkts++;
+		e->bytes += reqs[i].length;
+		e->last = reqs[i].timestamp;
+	}
+}
+
+/*
+ * Export flows idle since at least idle_ns or active for at least
+ * active_ns as of now into recs of size n. Idle flows are deleted,
+ * counters of active flows are restarted. Zero idle_ns exports and
+ * deletes all flows.
+ *
+ * Return number of exported records. If it equals n, the scan was
+ * interrupted and should be continued.
+ */
+static int
+flow_table_expire(struct flow_table *t, uint64_t now, uint64_t idle_ns,
+		uint64_t active_ns, struct flow_record *recs, int n)
+{
+	int k = 0;
+
+	for (; t->cursor <= t->mask && k < n; t->cursor++) {
+		struct flow_entry *e = &t->entries[t->cursor];
+		int idle, active;
+
+		if (e->state != FLOW_USED) {
+			continue;
+		}
+
+		// packets timestamped later than now are not idle unless
+		// all flows are exported
+		idle = idle_ns == 0 || (now >= e->last && now - e->last >= idle_ns);
+		active = active_ns > 0 && e->last - e->first >= active_ns;
+		if (!idle && !active) {
+			continue;
+		}
+
+		recs[k].hash = e->hash;
+		memcpy(recs[k].tuple, e->tuple, sizeof(e->tuple));
+		recs[k].tuple_len = e->tuple_len;
+		recs[k].portnum = e->portnum;
+		recs[k].pkts = e->pkts;
+		recs[k].bytes = e->bytes;
+		recs[k].first = e->first;
+		recs[k].last = e->last;
+		k++;
+
+		if (idle) {
+			e->state = FLOW_DELETED;
+			t->flows--;
+		} else {
+			e->pkts = 0;
+			e->bytes = 0;
+			e->first = e->last;
+		}
+	}
+
+	if (k < n) {
+		t->cursor = 0;
+	}
+
+	return k;
+}
+
+static void
+ring_reader_set_flows(struct ring_reader *reader, struct flow_table *t)
+{
+	reader->burst_fn = t != NULL ? flow_table_update : NULL;
+	reader->burst_ctx = t;
+}
+
+#endif /* _FLOW_TABLE_H_ */
@@ -0,0 +1,212 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"encoding/binary"
+	"syscall"
+	"testing"
+	"time"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+// Synthetic packets of flow f are sent from UDP port 1024+f and have
+// hash f*2654435761 which is stored at slot f&3 of a table of 4
+// entries.
+func flowHash(f int) uint32 {
+	return uint32(f) * 2654435761
+}
+
+// flowReader returns synthetic reader receiving packets one by one
+// with FlowTable of specified size attached.
+func flowReader(t *testing.T, size int) (*snf.RingReader, *snf.FlowTable, func()) {
+	assertFail := newAssert(t, true)
+
+	rr, teardown := mockupReader(t, "2", "64", time.Second, 1)
+	ft, err := snf.NewFlowTable(size, 0)
+	if err != nil {
+		teardown()
+		assertFail(false, err)
+	}
+	rr.SetFlowTable(ft)
+
+	return rr, ft, func() {
+		rr.SetFlowTable(nil)
+		ft.Free()
+		teardown()
+	}
+}
+
+// deliver filters out packets of other flows and returns timestamp of
+// the next packet of flow f accounted in the table.
+func deliver(t *testing.T, rr *snf.RingReader, f int) int64 {
+	assertFail := newAssert(t, true)
+
+	assertFail(rr.SetBPF(bpfUDPPortAt(34, uint32(1024+f))) == nil)
+	for !rr.Next() {
+		assertFail(rr.Err() == syscall.EAGAIN, rr.Err())
+	}
+	assertFail(binary.BigEndian.Uint16(rr.Data()[34:]) == uint16(1024+f))
+	return rr.RecvReq().Timestamp()
+}
+
+func TestFlowTableInsert(t *testing.T) {
+	rr, ft, teardown := flowReader(t, 16)
+	defer teardown()
+
+	first := deliver(t, rr, 1)
+	deliver(t, rr, 2)
+	deliver(t, rr, 1)
+	last := deliver(t, rr, 1)
+	if ft.Flows() != 2 || ft.Missed() != 0 {
+		t.Fatal(ft.Flows(), ft.Missed())
+	}
+
+	recs := map[uint32]snf.FlowRecord{}
+	if n := ft.Expire(last+1, 0, 0, func(r *snf.FlowRecord) {
+		recs[r.Hash()] = *r
+	}); n != 2 || ft.Flows() != 0 {
+		t.Fatal(n, ft.Flows())
+	}
+
+	r := recs[flowHash(1)]
+	if r.Pkts() != 3 || r.Bytes() != 3*64 || r.First() != first || r.Last() != last {
+		t.Error(r.Pkts(), r.Bytes(), r.First(), r.Last())
+	}
+	if sport, dport, ok := r.Ports(); !ok || sport != 1025 || dport != 1234 {
+		t.Error(sport, dport, ok)
+	}
+	if r = recs[flowHash(2)]; r.Pkts() != 1 || r.First() != r.Last() {
+		t.Error(r.Pkts(), r.First(), r.Last())
+	}
+}
+
+func TestFlowTableExpire(t *testing.T) {
+	rr, ft, teardown := flowReader(t, 16)
+	defer teardown()
+
+	t1 := deliver(t, rr, 1)
+	t2 := deliver(t, rr, 2)
+	deliver(t, rr, 3)
+
+	var got []uint32
+	fn := func(r *snf.FlowRecord) { got = append(got, r.Hash()) }
+
+	// flow 3 is ahead of now and is not idle
+	idle := time.Duration(t2 - t1)
+	if n := ft.Expire(t2, idle, 0, fn); n != 1 || got[0] != flowHash(1) || ft.Flows() != 2 {
+		t.Fatal(n, got, ft.Flows())
+	}
+
+	// active flows are exported and restarted
+	t4 := deliver(t, rr, 2)
+	got = got[:0]
+	if n := ft.Expire(t4, time.Hour, time.Duration(t4-t2), fn); n != 1 || got[0] != flowHash(2) || ft.Flows() != 2 {
+		t.Fatal(n, got, ft.Flows())
+	}
+	got = got[:0]
+	if n := ft.Expire(t4, time.Hour, time.Duration(t4-t2), fn); n != 0 {
+		t.Fatal(n, got)
+	}
+
+	// zero idle exports all flows, even ahead of now
+	if n := ft.Expire(t1, 0, 0, fn); n != 2 || ft.Flows() != 0 {
+		t.Fatal(n, ft.Flows())
+	}
+}
+
+func TestFlowTableTombstone(t *testing.T) {
+	rr, ft, teardown := flowReader(t, 4)
+	defer teardown()
+
+	deliver(t, rr, 0)
+	deliver(t, rr, 2)
+	t3 := deliver(t, rr, 3)
+	t1 := deliver(t, rr, 1)
+	if ft.Flows() != 4 {
+		t.Fatal(ft.Flows())
+	}
+
+	// table is full
+	deliver(t, rr, 4)
+	if ft.Missed() != 1 {
+		t.Fatal(ft.Missed())
+	}
+
+	// slots 0, 2 and 3 become tombstones
+	if n := ft.Expire(t1, time.Duration(t1-t3), 0, func(*snf.FlowRecord) {}); n != 3 || ft.Flows() != 1 {
+		t.Fatal(n, ft.Flows())
+	}
+
+	// new flows reuse tombstones
+	t4 := deliver(t, rr, 4)
+	t1 = deliver(t, rr, 1)
+	deliver(t, rr, 5)
+	deliver(t, rr, 8)
+	if ft.Flows() != 4 || ft.Missed() != 1 {
+		t.Fatal(ft.Flows(), ft.Missed())
+	}
+
+	// flow 8 is stored in slot 3 past tombstone of flow 4 in slot 0
+	if n := ft.Expire(t1, time.Duration(t1-t4), 0, func(*snf.FlowRecord) {}); n != 1 || ft.Flows() != 3 {
+		t.Fatal(n, ft.Flows())
+	}
+	deliver(t, rr, 8)
+	last := deliver(t, rr, 12)
+	if ft.Flows() != 4 || ft.Missed() != 1 {
+		t.Fatal(ft.Flows(), ft.Missed())
+	}
+
+	pkts := map[uint32]uint64{}
+	ft.Expire(last, 0, 0, func(r *snf.FlowRecord) { pkts[r.Hash()] = r.Pkts() })
+	if len(pkts) != 4 || pkts[flowHash(1)] != 2 || pkts[flowHash(5)] != 1 ||
+		pkts[flowHash(8)] != 2 || pkts[flowHash(12)] != 1 {
+		t.Fatal(pkts)
+	}
+}
+
+func TestFlowTableCursor(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	rr, ft, teardown := flowReader(t, 1024)
+	defer teardown()
+
+	// more flows than exported in a single scan, synthetic flows
+	// don't collide in the table
+	var last int64
+	for i := 0; i < 256; i++ {
+		assertFail(rr.Next(), rr.Err())
+		last = rr.RecvReq().Timestamp()
+	}
+	assertFail(ft.Flows() == 256, ft.Flows())
+
+	seen := map[uint32]int{}
+	n := ft.Expire(last, 0, 0, func(r *snf.FlowRecord) { seen[r.Hash()]++ })
+	if n != 256 || len(seen) != 256 || ft.Flows() != 0 {
+		t.Fatal(n, len(seen), ft.Flows())
+	}
+	for h, k := range seen {
+		if k != 1 {
+			t.Fatal(h, k)
+		}
+	}
+
+	// scan starts over
+	last = deliver(t, rr, 3)
+	if n = ft.Expire(last, 0, 0, func(*snf.FlowRecord) {}); n != 1 {
+		t.Fatal(n)
+	}
+}
+
+func TestNewFlowTableSize(t *testing.T) {
+	if _, err := snf.NewFlowTable(1<<31+1, 0); err != syscall.EINVAL {
+		t.Fatal(err)
+	}
+}
@@ -13,21 +13,28 @@ import (
 
 func reqDataCi(req *RecvReq) (data []byte, ci gopacket.CaptureInfo) {
 	data = req.Data()
-	return data, gopacket.CaptureInfo{
-		CaptureLength:  len(data),
-		InterfaceIndex: req.PortNum(),
-		Length:         len(data),
-		Timestamp:      time.Unix(0, req.Timestamp()),
-	}
+	req.FillCaptureInfo(&ci)
+	return
 }
 
 // CaptureInfo returns gopacket.CaptureInfo metadata for retrieved
 // packet.
 func (req *RecvReq) CaptureInfo() (ci gopacket.CaptureInfo) {
-	_, ci = reqDataCi(req)
+	req.FillCaptureInfo(&ci)
 	return
 }
 
+// FillCaptureInfo fills gopacket.CaptureInfo metadata for retrieved
+// packet in place.
+func (req *RecvReq) FillCaptureInfo(ci *gopacket.CaptureInfo) {
+	n := int(req.length)
+	ci.CaptureLength = n
+	ci.InterfaceIndex = req.PortNum()
+	ci.Length = n
+	ci.Timestamp = time.Unix(0, req.Timestamp())
+	ci.AncillaryData = nil
+}
+
 var _ gopacket.ZeroCopyPacketDataSource = (*RingReader)(nil)
 var _ gopacket.PacketDataSource = (*RingReader)(nil)
 
@@ -43,9 +50,12 @@ func (rr *RingReader) ZeroCopyReadPacketData() (data []byte, ci gopacket.Capture
 }
 
 // ReadPacketData implements gopacket.PacketDataSource.
+//
+// The packet data is copied into Arena if it was specified with
+// SetArena().
 func (rr *RingReader) ReadPacketData() (data []byte, ci gopacket.CaptureInfo, err error) {
 	if data, ci, err = rr.ZeroCopyReadPacketData(); err == nil {
-		data = append(make([]byte, 0, len(data)), data...)
+		data = rr.copyData(data)
 	}
 	return
 }
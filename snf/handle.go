@@ -2,6 +2,7 @@ package snf
 
 /*
 #include "wrapper.h"
+#include "rss_hash.h"
 */
 import "C"
 
@@ -168,6 +169,43 @@ func HandlerOptRssFunc(fn *CHashFunc, ctx unsafe.Pointer) HandlerOption {
 	}}
 }
 
+// Flags for built-in RSS hash function specified with
+// HandlerOptRssHash option. IP addresses are always included in the
+// hash. VLAN tags and MPLS labels are skipped.
+const (
+	// RssHashL4 includes TCP/UDP/SCTP source and destination ports
+	// in the hash. Fragmented IPv4 packets are hashed on addresses
+	// only so that all fragments go to the same ring.
+	RssHashL4 int = C.RSS_HASH_L4
+	// RssHashInner makes the hash to be calculated over the inner
+	// headers of VXLAN (UDP port 4789) and GTP-U (UDP port 2152)
+	// tunnelled packets.
+	RssHashInner = C.RSS_HASH_INNER
+)
+
+// HandlerOptRssHash specifies built-in C hash function to use by RSS
+// mechanism. The function calculates symmetric Toeplitz hash so that
+// both directions of a flow are delivered to the same ring. flags is
+// a mask of RssHashL4 and RssHashInner. This parameter is only
+// meaningful if there are more than 1 rings to be opened.
+//
+// Non-IP packets are delivered to the ring of hash value 0.
+//
+// Note that this option unsets HandlerOptRssFlags and
+// HandlerOptRssFunc options.
+func HandlerOptRssHash(flags int) HandlerOption {
+	return HandlerOption{func(opts *handlerOpts) {
+		opts.rss = &C.struct_snf_rss_params{}
+		C.set_rss_hash(opts.rss, C.int(flags))
+	}}
+}
+
+// rssHash calculates the hash of the packet as HandlerOptRssHash
+// does.
+func rssHash(req *RecvReq, flags int) uint32 {
+	return uint32(C.rss_hash_sym((*C.struct_snf_recv_req)(req), C.int(flags)))
+}
+
 func handle(h *Handle) C.snf_handle_t {
 	return C.snf_handle_t(unsafe.Pointer(h))
 }
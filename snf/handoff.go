@@ -0,0 +1,221 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+*/
+import "C"
+
+import (
+	"runtime"
+	"sync/atomic"
+	"syscall"
+	"time"
+)
+
+// HandOff is a lock-free single-producer/multi-consumer queue of
+// packets received from a ring. It transfers ownership of packet
+// descriptors to consumers so that they may process data in place
+// without copying it. Memory of the packets is returned to the ring
+// once consumers Release() them.
+//
+// SNF returns borrowed data in FIFO order, so the memory is returned
+// up to the earliest packet which is still held by a consumer. Slow
+// consumers may therefore hold the ring memory of packets which were
+// already released.
+//
+// HandOff uses snf_ring_recv_many() so it doesn't work with
+// aggregated rings.
+type HandOff struct {
+	ring      *Ring
+	timeoutMs C.int
+	mask      uint64
+
+	reqs []RecvReq
+	refs []int32
+
+	// pending packets are in [read, head), outstanding packets are in
+	// [tail, head).
+	head uint64
+	read uint64
+	tail uint64
+
+	closed uint32
+	qinfo  RingQInfo
+}
+
+// HandOffReq is a packet owned by a consumer of HandOff.
+type HandOffReq struct {
+	h   *HandOff
+	idx uint64
+}
+
+// NewHandOff creates HandOff for a ring. size is the maximum number
+// of outstanding packets and is rounded up to a power of 2. timeout
+// semantics is the same as addressed in Ring's Recv() method.
+func NewHandOff(r *Ring, timeout time.Duration, size int) *HandOff {
+	n := 1
+	for n < size {
+		n <<= 1
+	}
+
+	return &HandOff{
+		ring:      r,
+		timeoutMs: dur2ms(timeout),
+		mask:      uint64(n - 1),
+		reqs:      make([]RecvReq, n),
+		refs:      make([]int32, n),
+	}
+}
+
+// Produce returns memory of released packets to the ring and receives
+// new packets into free slots. It should be called by a single
+// producer goroutine, presumably in a loop.
+//
+// The output is the number of received packets and an error if any.
+// EAGAIN error means that no packets are available or there are no
+// free slots.
+func (h *HandOff) Produce() (int, error) {
+	if err := h.reclaim(); err != nil {
+		return 0, err
+	}
+
+	head := h.head
+	free := uint64(len(h.reqs)) - (head - h.tail)
+	if free == 0 {
+		return 0, syscall.EAGAIN
+	}
+
+	// receive into contiguous region of slots
+	lo := head & h.mask
+	hi := lo + free
+	if hi > uint64(len(h.reqs)) {
+		hi = uint64(len(h.reqs))
+	}
+
+	out := C.ring_recv_many(ring(h.ring), h.timeoutMs,
+		(*C.struct_snf_recv_req)(&h.reqs[lo]), C.int(hi-lo),
+		(*C.struct_snf_ring_qinfo)(&h.qinfo))
+	n, err := intErr(&out)
+	if err != nil {
+		return 0, err
+	}
+
+	for i := lo; i < lo+uint64(n); i++ {
+		atomic.StoreInt32(&h.refs[i], 1)
+	}
+
+	atomic.StoreUint64(&h.head, head+uint64(n))
+	return n, nil
+}
+
+// reclaim returns data of released packets up to the earliest
+// outstanding packet.
+func (h *HandOff) reclaim() error {
+	var datalen C.uint
+	tail, head := h.tail, h.head
+
+	for ; tail < head && atomic.LoadInt32(&h.refs[tail&h.mask]) == 0; tail++ {
+		datalen += h.reqs[tail&h.mask].length_data
+	}
+
+	if datalen == 0 {
+		return nil
+	}
+
+	err := retErr(C.snf_ring_return_many(ring(h.ring), datalen,
+		(*C.struct_snf_ring_qinfo)(&h.qinfo)))
+	if err == nil {
+		atomic.StoreUint64(&h.tail, tail)
+	}
+	return err
+}
+
+// QInfo returns queue consumption information as it was reported by
+// SNF upon the last Produce() call. It should be called by the
+// producer.
+func (h *HandOff) QInfo() *RingQInfo {
+	return &h.qinfo
+}
+
+// Outstanding returns the number of packets which were received and
+// not yet returned to the ring.
+func (h *HandOff) Outstanding() int {
+	return int(atomic.LoadUint64(&h.head) - atomic.LoadUint64(&h.tail))
+}
+
+// Close signals consumers that no more packets will be produced.
+// Consumers' Get() returns false once all pending packets are
+// consumed.
+func (h *HandOff) Close() {
+	atomic.StoreUint32(&h.closed, 1)
+}
+
+// TryGet retrieves next pending packet without blocking. If false is
+// returned, no packets are pending. It is safe to call TryGet from
+// multiple goroutines.
+func (h *HandOff) TryGet() (HandOffReq, bool) {
+	for {
+		read := atomic.LoadUint64(&h.read)
+		if read >= atomic.LoadUint64(&h.head) {
+			return HandOffReq{}, false
+		}
+
+		if atomic.CompareAndSwapUint64(&h.read, read, read+1) {
+			return HandOffReq{h, read}, true
+		}
+	}
+}
+
+// Get retrieves next pending packet. It spins until a packet is
+// available or HandOff is closed in which case false is returned. It
+// is safe to call Get from multiple goroutines.
+func (h *HandOff) Get() (HandOffReq, bool) {
+	for {
+		if req, ok := h.TryGet(); ok {
+			return req, true
+		}
+
+		if atomic.LoadUint32(&h.closed) != 0 {
+			// re-check to avoid losing packets produced
+			// before closing
+			return h.TryGet()
+		}
+
+		runtime.Gosched()
+	}
+}
+
+// RecvReq returns packet descriptor. It is valid until the packet is
+// released.
+func (r HandOffReq) RecvReq() *RecvReq {
+	return &r.h.reqs[r.idx&r.h.mask]
+}
+
+// Data returns packet data. It is valid until the packet is released.
+func (r HandOffReq) Data() []byte {
+	return r.RecvReq().Data()
+}
+
+// Retain adds a reference to the packet so that it may be shared with
+// other goroutines. Every Retain() should be paired with Release().
+func (r HandOffReq) Retain() {
+	r.retain(1)
+}
+
+// retain adds n references to the packet.
+func (r HandOffReq) retain(n int32) {
+	atomic.AddInt32(&r.h.refs[r.idx&r.h.mask], n)
+}
+
+// Release drops a reference to the packet. Once all references are
+// dropped, the packet memory may be returned to the ring and the
+// packet may not be accessed anymore.
+func (r HandOffReq) Release() {
+	atomic.AddInt32(&r.h.refs[r.idx&r.h.mask], -1)
+}
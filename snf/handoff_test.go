@@ -0,0 +1,120 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"runtime"
+	"syscall"
+	"testing"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+// getAll retrieves all pending packets of HandOff.
+func getAll(h *snf.HandOff) (reqs []snf.HandOffReq) {
+	for req, ok := h.TryGet(); ok; req, ok = h.TryGet() {
+		reqs = append(reqs, req)
+	}
+	return
+}
+
+func TestHandOffReclaim(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	r, teardown := mockupRing(t, "2", "64")
+	defer teardown()
+
+	h := snf.NewHandOff(r, 0, 8)
+	n, err := h.Produce()
+	assertFail(n == 8 && err == nil, n, err)
+
+	reqs := getAll(h)
+	assertFail(len(reqs) == 8, len(reqs))
+
+	// no free slots
+	_, err = h.Produce()
+	assertFail(err == syscall.EAGAIN, err)
+
+	// the earliest packet holds the rest
+	for _, req := range reqs[1:] {
+		req.Release()
+	}
+	_, err = h.Produce()
+	assertFail(err == syscall.EAGAIN, err)
+	assertFail(h.Outstanding() == 8, h.Outstanding())
+
+	// shared packet is held until all references are dropped
+	reqs[0].Retain()
+	reqs[0].Release()
+	_, err = h.Produce()
+	assertFail(err == syscall.EAGAIN, err)
+
+	reqs[0].Release()
+	n, err = h.Produce()
+	assertFail(n == 8 && err == nil, n, err)
+	assertFail(h.Outstanding() == 8, h.Outstanding())
+
+	// released out of order, reclaimed up to the held packet
+	reqs = getAll(h)
+	assertFail(len(reqs) == 8, len(reqs))
+	for _, i := range []int{0, 1, 3, 4} {
+		reqs[i].Release()
+	}
+	n, err = h.Produce()
+	assertFail(n == 2 && err == nil, n, err)
+
+	for _, i := range []int{2, 5, 6, 7} {
+		reqs[i].Release()
+	}
+	for _, req := range getAll(h) {
+		req.Release()
+	}
+	n, err = h.Produce()
+	assertFail(n > 0 && err == nil, n, err)
+	assertFail(h.Outstanding() == n, h.Outstanding(), n)
+}
+
+func TestHandOffConsumers(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	r, teardown := mockupRing(t, "2", "64")
+	defer teardown()
+
+	h := snf.NewHandOff(r, 0, 256)
+	const total = 4 * mockupRingPkts
+
+	done := make(chan int)
+	for i := 0; i < 4; i++ {
+		go func() {
+			n := 0
+			for req, ok := h.Get(); ok; req, ok = h.Get() {
+				req.Release()
+				n++
+			}
+			done <- n
+		}()
+	}
+
+	for produced := 0; produced < total; {
+		n, err := h.Produce()
+		if err == syscall.EAGAIN {
+			runtime.Gosched()
+		} else if err != nil {
+			t.Fatal(err)
+		}
+		produced += n
+	}
+	h.Close()
+
+	consumed := 0
+	for i := 0; i < 4; i++ {
+		consumed += <-done
+	}
+	assertFail(consumed >= total, consumed)
+}
@@ -0,0 +1,170 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"math/bits"
+	"sync/atomic"
+	"time"
+)
+
+// number of sub-buckets per power of 2 is 1<<histSubBits, relative
+// error of recorded values is within 1/(1<<histSubBits)
+const histSubBits = 4
+
+// total number of buckets to cover uint64 range
+const histBuckets = (64 - histSubBits) << histSubBits
+
+// Histogram is a lock-free log-linear histogram of values in the spirit
+// of HdrHistogram. Every power of 2 range of values is divided into 16
+// buckets so values are recorded with relative error of 6.25% at most.
+//
+// Record() may be called concurrently with readers of the histogram
+// and with other writers. The zero value is an empty histogram ready
+// to use.
+type Histogram struct {
+	counts [histBuckets]uint64
+	count  uint64
+	sum    uint64
+}
+
+func histIndex(v uint64) int {
+	if v < 1<<histSubBits {
+		return int(v)
+	}
+	shift := uint(bits.Len64(v)) - histSubBits - 1
+	return int(shift+1)<<histSubBits + int(v>>shift) - 1<<histSubBits
+}
+
+// histUpper returns the exclusive upper bound of bucket i.
+func histUpper(i int) uint64 {
+	if i < 1<<histSubBits {
+		return uint64(i) + 1
+	}
+	shift := uint(i>>histSubBits) - 1
+	base := uint64(i&(1<<histSubBits-1)) + 1<<histSubBits
+	return (base + 1) << shift
+}
+
+// Record adds value v to the histogram. Negative values are recorded
+// as 0.
+func (h *Histogram) Record(v int64) {
+	if v < 0 {
+		v = 0
+	}
+	atomic.AddUint64(&h.counts[histIndex(uint64(v))], 1)
+	atomic.AddUint64(&h.count, 1)
+	atomic.AddUint64(&h.sum, uint64(v))
+}
+
+// Count returns the number of recorded values.
+func (h *Histogram) Count() uint64 {
+	return atomic.LoadUint64(&h.count)
+}
+
+// Sum returns the sum of recorded values.
+func (h *Histogram) Sum() uint64 {
+	return atomic.LoadUint64(&h.sum)
+}
+
+// Quantile returns the upper bound of the bucket containing the
+// value at quantile q, e.g. 0.99. It returns 0 if histogram is empty.
+func (h *Histogram) Quantile(q float64) uint64 {
+	var counts [histBuckets]uint64
+	var total uint64
+	for i := range counts {
+		counts[i] = atomic.LoadUint64(&h.counts[i])
+		total += counts[i]
+	}
+
+	if total == 0 {
+		return 0
+	}
+
+	rank := uint64(q * float64(total))
+	if rank >= total {
+		rank = total - 1
+	}
+
+	var n uint64
+	for i, c := range counts {
+		if n += c; n > rank {
+			return histUpper(i) - 1
+		}
+	}
+	return 0
+}
+
+// CountBelow returns the number of recorded values less than v. The
+// result is exact if v is a power of 2.
+func (h *Histogram) CountBelow(v uint64) (n uint64) {
+	for i := range h.counts {
+		if histUpper(i) > v {
+			break
+		}
+		n += atomic.LoadUint64(&h.counts[i])
+	}
+	return
+}
+
+// Reset clears the histogram. Values recorded concurrently may be
+// lost.
+func (h *Histogram) Reset() {
+	for i := range h.counts {
+		atomic.StoreUint64(&h.counts[i], 0)
+	}
+	atomic.StoreUint64(&h.count, 0)
+	atomic.StoreUint64(&h.sum, 0)
+}
+
+// LatencyStats holds distributions of packet timestamps observed by
+// RingReader, in nanoseconds. See RingReader's SetLatencyStats().
+type LatencyStats struct {
+	// Capture to processing latency, i.e. host clock at the time of
+	// burst receive minus packet's hardware timestamp. The host
+	// clock is supposed to be synchronized with the NIC.
+	Latency Histogram
+
+	// Difference of hardware timestamps of consecutive packets of a
+	// reader.
+	InterArrival Histogram
+}
+
+// record adds timestamps of the burst received at now. last is the
+// timestamp of the previous packet of the reader, or 0. The timestamp
+// of the last packet of the burst is returned.
+func (s *LatencyStats) record(reqs []RecvReq, now, last int64) int64 {
+	for i := range reqs {
+		ts := reqs[i].Timestamp()
+		s.Latency.Record(now - ts)
+		if last != 0 {
+			s.InterArrival.Record(ts - last)
+		}
+		last = ts
+	}
+	return last
+}
+
+// SetLatencyStats enables recording of latency and inter-arrival
+// distributions of every received burst into s. The host clock is
+// read once per burst. Nil disables recording.
+//
+// The same LatencyStats may be shared between readers, in which case
+// inter-arrival times are still measured between packets of the same
+// reader.
+func (rr *RingReader) SetLatencyStats(s *LatencyStats) {
+	rr.lat = s
+	rr.latLast = 0
+}
+
+// recordLatency records latency stats of the current burst if they
+// are enabled.
+func (rr *RingReader) recordLatency() {
+	if rr.lat != nil {
+		rr.latLast = rr.lat.record(rr.burst, time.Now().UnixNano(), rr.latLast)
+	}
+}
@@ -0,0 +1,97 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"bytes"
+	"strings"
+	"testing"
+)
+
+func TestHistIndexUpper(t *testing.T) {
+	var lower uint64
+	for i := 0; i < histBuckets; i++ {
+		upper := histUpper(i)
+		if upper <= lower {
+			t.Fatalf("bucket %d: upper %d not above lower %d", i, upper, lower)
+		}
+		if j := histIndex(lower); j != i {
+			t.Fatalf("bucket %d: lower %d maps to %d", i, lower, j)
+		}
+		if j := histIndex(upper - 1); j != i {
+			t.Fatalf("bucket %d: upper %d maps to %d", i, upper-1, j)
+		}
+		if lower >= 1<<histSubBits && (upper-lower)<<histSubBits > lower {
+			t.Fatalf("bucket %d: [%d, %d) is too wide", i, lower, upper)
+		}
+		lower = upper
+	}
+
+	// covers all values recorded from int64
+	if lower != 1<<63 {
+		t.Fatalf("last bucket ends at %d", lower)
+	}
+}
+
+func TestHistogramCountBelow(t *testing.T) {
+	var h Histogram
+	for v := int64(0); v < 5000; v++ {
+		h.Record(v)
+	}
+	h.Record(-1)
+
+	if h.Count() != 5001 || h.Sum() != 4999*5000/2 {
+		t.Fatal(h.Count(), h.Sum())
+	}
+
+	for shift := uint(0); shift < 13; shift++ {
+		v := uint64(1) << shift
+		if n := h.CountBelow(v); n != v+1 {
+			t.Errorf("below %d: %d", v, n)
+		}
+	}
+
+	// relative error of quantiles is within a bucket
+	for _, q := range []float64{0.1, 0.5, 0.9, 0.99} {
+		want := q * 5000
+		if got := float64(h.Quantile(q)); got < want || got > want*(1+1.0/(1<<histSubBits)) {
+			t.Errorf("quantile %g: %g, want %g", q, got, want)
+		}
+	}
+
+	h.Reset()
+	if h.Count() != 0 || h.Quantile(0.5) != 0 {
+		t.Fatal(h.Count(), h.Quantile(0.5))
+	}
+}
+
+func TestPromHistogramLe(t *testing.T) {
+	var h Histogram
+	h.Record(1023)
+	h.Record(1024)
+	h.Record(2047)
+	h.Record(2048)
+
+	p := NewPromWriter()
+	p.Histogram("lat_seconds", "Latency.", &h, "ring", "0")
+	var b bytes.Buffer
+	if _, err := p.WriteTo(&b); err != nil {
+		t.Fatal(err)
+	}
+
+	for _, s := range []string{
+		`lat_seconds_bucket{ring="0",le="1.023e-06"} 1`,
+		`lat_seconds_bucket{ring="0",le="2.047e-06"} 3`,
+		`lat_seconds_bucket{ring="0",le="4.095e-06"} 4`,
+		`lat_seconds_bucket{ring="0",le="+Inf"} 4`,
+		`lat_seconds_count{ring="0"} 4`,
+	} {
+		if !strings.Contains(b.String(), s+"\n") {
+			t.Errorf("%q not found in:\n%s", s, b.String())
+		}
+	}
+}
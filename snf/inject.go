@@ -23,12 +23,40 @@ int go_inject_sched_v(snf_inject_t inj, int timeout_ms, int flags,
 	   (struct snf_pkt_fragment *)frags_vec, nfrags,
 	   length_hint, delay_ns);
 }
+
+// Send npkts packets described by fragments, one fragment per packet.
+// If delays is not 0, it points to array of npkts delays and packets
+// are scheduled. Returns the number of sent packets and the first
+// error.
+struct compound_int go_inject_batch(snf_inject_t inj, int timeout_ms, int flags,
+       uintptr_t pkts_vec, int npkts, uintptr_t delays)
+{
+	struct compound_int out;
+	struct snf_pkt_fragment *pkts = (struct snf_pkt_fragment *)pkts_vec;
+	const uint64_t *delay_ns = (const uint64_t *)delays;
+	int i, rc = 0;
+
+	for (i = 0; i < npkts; i++) {
+		rc = delay_ns == NULL ?
+		   snf_inject_send(inj, timeout_ms, flags, pkts[i].ptr, pkts[i].length) :
+		   snf_inject_sched(inj, timeout_ms, flags, pkts[i].ptr, pkts[i].length,
+		       delay_ns[i]);
+		if (rc != 0)
+			break;
+	}
+
+	out.i[0] = i;
+	out.rc = rc;
+	return out;
+}
 */
 import "C"
 
 import (
 	"fmt"
 	"os"
+	"runtime"
+	"syscall"
 	"time"
 	"unsafe"
 )
@@ -118,7 +146,11 @@ func (h *InjectHandle) Close() error {
 // Statistics are only updated by the NIC periodically.
 func (h *InjectHandle) GetStats() (*InjectStats, error) {
 	stats := &InjectStats{}
-	return stats, retErr(C.snf_inject_getstats(injHandle(h),
+	return stats, h.getStats(stats)
+}
+
+func (h *InjectHandle) getStats(stats *InjectStats) error {
+	return retErr(C.snf_inject_getstats(injHandle(h),
 		(*C.struct_snf_inject_stats)(unsafe.Pointer(stats))))
 }
 
@@ -370,3 +402,81 @@ func (s *Sender) SchedVec(delayNs int64, pkt ...[]byte) error {
 		s.flags, C.uintptr_t(uintptr(unsafe.Pointer(&s.frags[0]))), C.int(len(pkt)),
 		hint, C.ulong(delayNs)))
 }
+
+// SendBatch sends a batch of packets with a single cgo call. Every
+// packet follows the semantics of Send. The signal channel installed
+// with NotifyWith is checked once per batch.
+//
+// The output is the number of packets which were successfully sent
+// and the error which stopped the batch, if any. The packets
+// following the failed one are not sent.
+func (s *Sender) SendBatch(pkts [][]byte) (int, error) {
+	return s.batch(nil, pkts)
+}
+
+// SchedBatch sends a batch of packets with hardware delays with a
+// single cgo call. Every packet follows the semantics of Sched with
+// corresponding delay in delayNs. The signal channel installed with
+// NotifyWith is checked once per batch.
+//
+// The output is the number of packets which were successfully sent
+// and the error which stopped the batch, if any. The packets
+// following the failed one are not sent.
+//
+// EINVAL error will be returned if the number of delays doesn't
+// match the number of packets.
+func (s *Sender) SchedBatch(delayNs []int64, pkts [][]byte) (int, error) {
+	if len(delayNs) != len(pkts) {
+		return 0, syscall.EINVAL
+	}
+	return s.batch(delayNs, pkts)
+}
+
+func (s *Sender) batch(delayNs []int64, pkts [][]byte) (int, error) {
+	if err := s.checkSignal(); err != nil {
+		return 0, err
+	}
+
+	if len(pkts) == 0 {
+		return 0, nil
+	}
+
+	var delays uintptr
+	if delayNs != nil {
+		delays = uintptr(unsafe.Pointer(&delayNs[0]))
+	}
+
+	s.checkFragBuf(len(pkts))
+	makeFrags(pkts, s.frags)
+	out := C.go_inject_batch(injHandle(s.InjectHandle), s.timeoutMs,
+		s.flags, C.uintptr_t(uintptr(unsafe.Pointer(&s.frags[0]))),
+		C.int(len(pkts)), C.uintptr_t(delays))
+	runtime.KeepAlive(pkts)
+	runtime.KeepAlive(delayNs)
+	return intErr(&out)
+}
+
+// Forward injects packets of received descriptors, e.g. obtained with
+// RingReader's NextBatch(), straight from the receive ring memory
+// with a single cgo call. Every packet follows the semantics of Send.
+// To forward only selected packets of a burst, copy their descriptors
+// into a separate slice; payload is never touched by Go.
+//
+// Since SNF buffers injected packets completely, the received burst
+// may be returned to the ring as soon as Forward returns.
+//
+// The output is the number of packets which were successfully sent
+// and the error which stopped the batch, if any.
+func (s *Sender) Forward(reqs []RecvReq) (int, error) {
+	if err := s.checkSignal(); err != nil {
+		return 0, err
+	}
+
+	if len(reqs) == 0 {
+		return 0, nil
+	}
+
+	out := C.inject_recv_reqs(injHandle(s.InjectHandle), s.timeoutMs,
+		s.flags, (*C.struct_snf_recv_req)(&reqs[0]), C.int(len(reqs)))
+	return intErr(&out)
+}
@@ -0,0 +1,424 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"math"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+)
+
+// injectLinkDownSpeed is the speed in bits per second assumed for
+// ports with link down until their throughput is measured.
+const injectLinkDownSpeed = 1000000000
+
+// InjectBatch is a batch of packets queued to InjectScheduler.
+type InjectBatch struct {
+	// Pkts are the packets to send. They should not be modified until
+	// the batch is done.
+	Pkts [][]byte
+
+	// Delays, if not nil, holds packet delays, see Sender's
+	// SchedBatch().
+	Delays []int64
+
+	// Done, if not nil, is called by the sender goroutine once the
+	// batch is sent or failed. port is the index of the port the
+	// batch was sent to, sent is the number of sent packets.
+	Done func(b *InjectBatch, port, sent int, err error)
+
+	bytes uint64
+}
+
+// InjectScheduler options container
+type injectOpts struct {
+	handles  int
+	cpus     []int
+	timeout  time.Duration
+	queue    int
+	interval time.Duration
+}
+
+// InjectOption specifies an option for creating an InjectScheduler.
+type InjectOption struct {
+	f func(*injectOpts)
+}
+
+// InjectOptHandles limits the number of injection handles opened per
+// port. By default, the maximum number of injection handles of the
+// port is opened, see IfAddrs' MaxInject().
+func InjectOptHandles(n int) InjectOption {
+	return InjectOption{func(opts *injectOpts) {
+		opts.handles = n
+	}}
+}
+
+// InjectOptCPUs specifies CPU set to pin sender threads to. Sender
+// with id i is pinned to cpus[i%len(cpus)]. If not specified, threads
+// are not pinned.
+func InjectOptCPUs(cpus []int) InjectOption {
+	return InjectOption{func(opts *injectOpts) {
+		opts.cpus = cpus
+	}}
+}
+
+// InjectOptTimeout specifies send timeout of senders. It also limits
+// the time needed for the scheduler to stop. Default is 1ms.
+func InjectOptTimeout(d time.Duration) InjectOption {
+	return InjectOption{func(opts *injectOpts) {
+		opts.timeout = d
+	}}
+}
+
+// InjectOptQueue specifies the number of batches queued per sender.
+// Default is 64.
+func InjectOptQueue(n int) InjectOption {
+	return InjectOption{func(opts *injectOpts) {
+		opts.queue = n
+	}}
+}
+
+// InjectOptInterval specifies how often the throughput of ports is
+// sampled from injection statistics. Default is 100ms.
+func InjectOptInterval(d time.Duration) InjectOption {
+	return InjectOption{func(opts *injectOpts) {
+		opts.interval = d
+	}}
+}
+
+// injectPort is a port of InjectScheduler.
+type injectPort struct {
+	id      int
+	portnum int
+	senders []*injectSender
+
+	// bytes queued to senders of the port
+	queued uint64
+
+	// non-0 if queued dropped to 0 since the last sample
+	drained uint32
+
+	// estimated throughput in bytes per second, float64 bits
+	rate uint64
+
+	// last statistics sample, accessed by the first sender only
+	lastBytes uint64
+	lastTime  int64
+}
+
+// injectSender owns an injection handle and runs on its own
+// goroutine.
+type injectSender struct {
+	*Sender
+	port   *injectPort
+	ch     chan *InjectBatch
+	queued uint64
+	stats  InjectStats
+}
+
+// InjectScheduler distributes batches of packets across several ports
+// and a pool of injection handles of every port. Each injection handle
+// is owned by a single sender goroutine locked to an OS thread, so
+// handles are never shared and sending requires no locking.
+//
+// A batch is queued to the port with the least expected time to send
+// its backlog, estimated from the throughput of the port observed
+// with injection statistics while the port was busy, or from the link
+// speed until the port was measured. Within the port the batch goes
+// to the sender with the least backlog.
+type InjectScheduler struct {
+	opts    injectOpts
+	ports   []*injectPort
+	senders []*injectSender
+
+	wg      sync.WaitGroup
+	stopped uint32
+	errMtx  sync.Mutex
+	err     error
+}
+
+// NewInjectScheduler opens injection handles on ports with specified
+// port numbers and creates a sender for each of them. Opening handles
+// of a port stops on EBUSY error, i.e. if other processes hold some of
+// the port's handles. At least one handle per port should be opened.
+//
+// If any port fails, all previously opened handles are closed and the
+// error is returned.
+func NewInjectScheduler(ports []int, options ...InjectOption) (*InjectScheduler, error) {
+	s := &InjectScheduler{
+		opts: injectOpts{
+			timeout:  time.Millisecond,
+			queue:    64,
+			interval: 100 * time.Millisecond,
+		},
+	}
+
+	for _, opt := range options {
+		opt.f(&s.opts)
+	}
+
+	ifaddrs, err := GetIfAddrs()
+	if err != nil {
+		return nil, err
+	}
+
+	for _, portnum := range ports {
+		n := 0
+		for i := range ifaddrs {
+			if int(ifaddrs[i].PortNum()) == portnum {
+				n = ifaddrs[i].MaxInject()
+			}
+		}
+		if s.opts.handles > 0 && s.opts.handles < n {
+			n = s.opts.handles
+		}
+
+		if err = s.openPort(portnum, n); err != nil {
+			s.Close()
+			return nil, err
+		}
+	}
+
+	return s, nil
+}
+
+func (s *InjectScheduler) openPort(portnum, n int) error {
+	p := &injectPort{id: len(s.ports), portnum: portnum}
+	for i := 0; i < n; i++ {
+		h, err := OpenInjectHandle(portnum)
+		if err == syscall.EBUSY && i > 0 {
+			break
+		} else if err != nil {
+			return err
+		}
+
+		if i == 0 {
+			// initial estimate is the link speed
+			var speed uint64
+			if speed, err = h.GetSpeed(); err != nil {
+				h.Close()
+				return err
+			}
+			if speed == 0 {
+				// link is down, the rate will be measured
+				// once it's up
+				speed = injectLinkDownSpeed
+			}
+			atomic.StoreUint64(&p.rate, math.Float64bits(float64(speed)/8))
+		}
+
+		is := &injectSender{
+			Sender: NewSender(h, s.opts.timeout, 0),
+			port:   p,
+			ch:     make(chan *InjectBatch, s.opts.queue),
+		}
+		p.senders = append(p.senders, is)
+		s.senders = append(s.senders, is)
+	}
+
+	if len(p.senders) == 0 {
+		return syscall.ENODEV
+	}
+
+	s.ports = append(s.ports, p)
+	return nil
+}
+
+// Ports returns the number of ports of the scheduler.
+func (s *InjectScheduler) Ports() int {
+	return len(s.ports)
+}
+
+// Handles returns the number of injection handles opened for i-th
+// port.
+func (s *InjectScheduler) Handles(i int) int {
+	return len(s.ports[i].senders)
+}
+
+// Throughput returns estimated throughput of i-th port in bytes per
+// second.
+func (s *InjectScheduler) Throughput(i int) float64 {
+	return math.Float64frombits(atomic.LoadUint64(&s.ports[i].rate))
+}
+
+// Start launches sender goroutines.
+func (s *InjectScheduler) Start() {
+	for i := range s.senders {
+		s.wg.Add(1)
+		go s.run(i)
+	}
+}
+
+func (s *InjectScheduler) setErr(err error) {
+	s.errMtx.Lock()
+	if s.err == nil {
+		s.err = err
+	}
+	s.errMtx.Unlock()
+}
+
+func (s *InjectScheduler) run(id int) {
+	defer s.wg.Done()
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	if cpus := s.opts.cpus; len(cpus) > 0 {
+		// keep draining the queue unpinned
+		if err := setAffinity(cpus[id%len(cpus)]); err != nil {
+			s.setErr(err)
+		}
+	}
+
+	is := s.senders[id]
+	sample := is == is.port.senders[0]
+	for b := range is.ch {
+		n, err := s.send(is, b)
+		atomic.AddUint64(&is.queued, -b.bytes)
+		if atomic.AddUint64(&is.port.queued, -b.bytes) == 0 {
+			atomic.StoreUint32(&is.port.drained, 1)
+		}
+		if err != nil && err != syscall.EAGAIN {
+			s.setErr(err)
+		}
+		if b.Done != nil {
+			b.Done(b, is.port.id, n, err)
+		}
+		if sample {
+			s.sample(is)
+		}
+	}
+}
+
+// send sends the batch retrying on EAGAIN until stopped.
+func (s *InjectScheduler) send(is *injectSender, b *InjectBatch) (sent int, err error) {
+	for sent < len(b.Pkts) {
+		var n int
+		if b.Delays != nil {
+			n, err = is.SchedBatch(b.Delays[sent:], b.Pkts[sent:])
+		} else {
+			n, err = is.SendBatch(b.Pkts[sent:])
+		}
+
+		sent += n
+		if err != syscall.EAGAIN {
+			break
+		} else if atomic.LoadUint32(&s.stopped) != 0 {
+			break
+		}
+		err = nil
+	}
+	return
+}
+
+// sample updates throughput estimate of the port from bytes sent by
+// the NIC. The NIC counters apply to all injection handles of the
+// port. Samples of intervals during which the port ran out of queued
+// bytes are discarded since they reflect the offered load rather than
+// the throughput of the port.
+func (s *InjectScheduler) sample(is *injectSender) {
+	p := is.port
+	now := time.Now().UnixNano()
+	dt := now - p.lastTime
+	if dt < s.opts.interval.Nanoseconds() {
+		return
+	}
+
+	if err := is.getStats(&is.stats); err != nil {
+		return
+	}
+
+	bytes := is.stats.NicBytesSend()
+	busy := atomic.SwapUint32(&p.drained, 0) == 0 && atomic.LoadUint64(&p.queued) != 0
+	if busy && p.lastTime != 0 && dt < 4*s.opts.interval.Nanoseconds() && bytes > p.lastBytes {
+		rate := float64(bytes-p.lastBytes) * 1e9 / float64(dt)
+		old := math.Float64frombits(atomic.LoadUint64(&p.rate))
+		atomic.StoreUint64(&p.rate, math.Float64bits((old+rate)/2))
+	}
+
+	p.lastBytes, p.lastTime = bytes, now
+}
+
+// Submit queues the batch to the port which is expected to send it
+// first and returns the index of the port. It blocks if the sender's
+// queue is full. Submit is safe for concurrent use but should not be
+// called after Stop().
+func (s *InjectScheduler) Submit(b *InjectBatch) int {
+	b.bytes = batchBytes(b.Pkts)
+
+	best, cost := 0, math.Inf(1)
+	for i, p := range s.ports {
+		rate := math.Float64frombits(atomic.LoadUint64(&p.rate))
+		c := float64(atomic.LoadUint64(&p.queued)+b.bytes) / rate
+		if c < cost {
+			best, cost = i, c
+		}
+	}
+
+	s.submit(s.ports[best], b)
+	return best
+}
+
+// SubmitPort queues the batch to i-th port, see Submit().
+func (s *InjectScheduler) SubmitPort(i int, b *InjectBatch) {
+	b.bytes = batchBytes(b.Pkts)
+	s.submit(s.ports[i], b)
+}
+
+func (s *InjectScheduler) submit(p *injectPort, b *InjectBatch) {
+	is := p.senders[0]
+	for _, x := range p.senders[1:] {
+		if atomic.LoadUint64(&x.queued) < atomic.LoadUint64(&is.queued) {
+			is = x
+		}
+	}
+
+	atomic.AddUint64(&is.queued, b.bytes)
+	atomic.AddUint64(&p.queued, b.bytes)
+	is.ch <- b
+}
+
+func batchBytes(pkts [][]byte) (n uint64) {
+	for _, pkt := range pkts {
+		n += uint64(len(pkt))
+	}
+	return
+}
+
+// Stop signals sender goroutines to exit once their queues are
+// drained. Use Wait() to wait for them to do so. Batches which can't
+// be sent without blocking after Stop() are done with EAGAIN error.
+func (s *InjectScheduler) Stop() {
+	if atomic.SwapUint32(&s.stopped, 1) == 0 {
+		for _, is := range s.senders {
+			close(is.ch)
+		}
+	}
+}
+
+// Wait waits for sender goroutines to exit and returns the first
+// error encountered by any of them.
+func (s *InjectScheduler) Wait() error {
+	s.wg.Wait()
+	s.errMtx.Lock()
+	defer s.errMtx.Unlock()
+	return s.err
+}
+
+// Close closes all injection handles ensuring pending packets are
+// sent. The scheduler should be stopped prior to closing.
+func (s *InjectScheduler) Close() error {
+	var err error
+	for _, is := range s.senders {
+		if e := is.InjectHandle.Close(); err == nil {
+			err = e
+		}
+	}
+	return err
+}
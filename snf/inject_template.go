@@ -0,0 +1,163 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which can be
+// found in the LICENSE file in the root of the source tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+#include "inject_template.h"
+*/
+import "C"
+
+import (
+	"unsafe"
+)
+
+// Fields of InjectTemplate which may be varied with Vary(). IPv6
+// addresses are varied in their last 4 bytes.
+const (
+	TmplSrcIP = iota
+	TmplDstIP
+	TmplSrcPort
+	TmplDstPort
+	TmplIPv4ID
+	TmplTCPSeq
+)
+
+// InjectTemplate is a packet template for generating traffic with a
+// few header fields varying per packet. The headers of the frame up
+// to the end of TCP or UDP header are copied and rewritten in C for
+// every packet while the payload is kept in a single shared
+// fragment. IPv4, TCP and UDP checksums are calculated once upon
+// creation and updated incrementally as fields change.
+//
+// InjectTemplate is not safe for concurrent use.
+type InjectTemplate struct {
+	t *C.struct_inject_template
+}
+
+// NewInjectTemplate creates InjectTemplate out of an Ethernet frame
+// carrying IPv4 or IPv6 packet, possibly VLAN tagged. The frame is
+// copied and its checksums are fixed.
+//
+// EINVAL is returned if the frame is not an IP packet or its headers
+// are longer than 128 bytes.
+func NewInjectTemplate(frame []byte) (*InjectTemplate, error) {
+	if len(frame) == 0 {
+		return nil, retErr(C.EINVAL)
+	}
+
+	t, err := C.inject_template_alloc(unsafe.Pointer(&frame[0]), C.uint32_t(len(frame)))
+	if t == nil {
+		return nil, err
+	}
+	return &InjectTemplate{t}, nil
+}
+
+// Free releases memory of the template.
+func (t *InjectTemplate) Free() {
+	C.inject_template_free(t.t)
+	t.t = nil
+}
+
+// HeaderLen returns length of the header fragment.
+func (t *InjectTemplate) HeaderLen() int {
+	return int(t.t.hdr_len)
+}
+
+// L3Offset returns offset of IP header in the frame.
+func (t *InjectTemplate) L3Offset() int {
+	return int(t.t.l3_off)
+}
+
+// L4Offset returns offset of TCP or UDP header in the frame, or 0 if
+// there is none.
+func (t *InjectTemplate) L4Offset() int {
+	return int(t.t.l4_off)
+}
+
+// AddField varies size bytes (1, 2 or 4) at offset off of the header
+// as a big endian number. The value for the packet with sequence
+// number seq is base + (seq % count) * step, or base + seq * step if
+// count is 0. The field should be within the header fragment and not
+// overlap checksums. Up to 8 fields may be added.
+//
+// EINVAL is returned if the field can't be added.
+func (t *InjectTemplate) AddField(off, size int, base, step, count uint32) error {
+	return retErr(C.inject_template_add_field(t.t, C.int(off), C.int(size),
+		C.uint32_t(base), C.uint32_t(step), C.uint32_t(count)))
+}
+
+// Vary varies one of well-known fields, see AddField(). base is
+// relative to the value of the field in the template frame, i.e. 0
+// base and 1 step for TmplSrcPort increments source port starting
+// from the original one.
+//
+// EINVAL is returned if the template doesn't have the field.
+func (t *InjectTemplate) Vary(field int, base, step, count uint32) error {
+	l3, l4 := int(t.t.l3_off), int(t.t.l4_off)
+	ipv4 := t.t.ipv4 != 0
+
+	var off, size int
+	switch {
+	case field == TmplSrcIP && ipv4:
+		off, size = l3+12, 4
+	case field == TmplDstIP && ipv4:
+		off, size = l3+16, 4
+	case field == TmplSrcIP:
+		off, size = l3+20, 4
+	case field == TmplDstIP:
+		off, size = l3+36, 4
+	case field == TmplSrcPort && l4 > 0:
+		off, size = l4, 2
+	case field == TmplDstPort && l4 > 0:
+		off, size = l4+2, 2
+	case field == TmplIPv4ID && ipv4:
+		off, size = l3+4, 2
+	case field == TmplTCPSeq && l4 > 0 && t.t.udp == 0:
+		off, size = l4+4, 4
+	default:
+		return retErr(C.EINVAL)
+	}
+
+	hdr := (*[C.INJECT_TEMPLATE_HDR_MAX]byte)(unsafe.Pointer(&t.t.base[0]))
+	var orig uint32
+	for _, b := range hdr[off : off+size] {
+		orig = orig<<8 | uint32(b)
+	}
+
+	return t.AddField(off, size, orig+base, step, count)
+}
+
+// packet builds the packet with sequence number seq and returns its
+// copy.
+func (t *InjectTemplate) packet(seq uint64) []byte {
+	C.inject_template_build(t.t, C.uint64_t(seq))
+	hdr := C.GoBytes(unsafe.Pointer(&t.t.hdr[0]), C.int(t.t.hdr_len))
+	return append(hdr, C.GoBytes(unsafe.Pointer(t.t.payload), C.int(t.t.payload_len))...)
+}
+
+// SendTemplate sends n packets of the template with sequence numbers
+// starting from seq with a single cgo call. Every packet follows the
+// semantics of SendVec.
+//
+// The output is the number of packets which were successfully sent
+// and the error which stopped the batch, if any.
+func (s *Sender) SendTemplate(t *InjectTemplate, seq uint64, n int) (int, error) {
+	return s.SchedTemplate(t, seq, n, 0)
+}
+
+// SchedTemplate is similar to SendTemplate but every packet is
+// scheduled with delayNs delay, see SchedVec. Zero delayNs sends
+// packets as soon as possible.
+func (s *Sender) SchedTemplate(t *InjectTemplate, seq uint64, n int, delayNs int64) (int, error) {
+	if err := s.checkSignal(); err != nil {
+		return 0, err
+	}
+
+	out := C.inject_template_send(injHandle(s.InjectHandle), s.timeoutMs,
+		s.flags, t.t, C.uint64_t(seq), C.int(n), C.uint64_t(delayNs))
+	return intErr(&out)
+}
@@ -0,0 +1,388 @@
+#ifndef _INJECT_TEMPLATE_H_
+#define _INJECT_TEMPLATE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wrapper.h"
+
+/*
+ * Maximum length of the header fragment of a template which is
+ * rewritten per packet.
+ */
+#define INJECT_TEMPLATE_HDR_MAX 128
+
+/*
+ * Maximum number of varied fields of a template.
+ */
+#define INJECT_TEMPLATE_FIELDS 8
+
+enum {
+	INJECT_CSUM_L3 = 0x1, // field is covered by IPv4 header checksum
+	INJECT_CSUM_L4 = 0x2, // field is covered by TCP/UDP checksum
+};
+
+/*
+ * Field of the header varied per packet. Value of the field for the
+ * packet with sequence number seq is base + (seq % count) * step, or
+ * base + seq * step if count is 0.
+ */
+struct inject_field {
+	uint16_t off;
+	uint8_t size; // 1, 2 or 4 bytes, big endian
+	uint8_t csum; // INJECT_CSUM_* flags
+	uint32_t base;
+	uint32_t step;
+	uint32_t count;
+};
+
+/*
+ * Packet template: the header fragment is copied and rewritten for
+ * every packet while the payload fragment is shared.
+ */
+struct inject_template {
+	uint8_t base[INJECT_TEMPLATE_HDR_MAX]; // original header
+	uint8_t hdr[INJECT_TEMPLATE_HDR_MAX]; // header being sent
+	uint32_t hdr_len;
+	uint8_t *payload;
+	uint32_t payload_len;
+
+	int l3_off;
+	int l3_end; // end of IP header
+	int l4_off; // 0 if not TCP or UDP
+	int addr_off; // IP addresses, part of TCP/UDP pseudo-header
+	int addr_end;
+	int ipv4;
+	int l3_csum_off; // 0 if none
+	int l4_csum_off; // 0 if none
+	int udp;
+
+	int nfields;
+	struct inject_field fields[INJECT_TEMPLATE_FIELDS];
+};
+
+static uint32_t
+inject_csum_add(uint32_t sum, const uint8_t *p, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i + 1 < len; i += 2) {
+		sum += (uint32_t)p[i] << 8 | p[i + 1];
+	}
+	if (len & 1) {
+		sum += (uint32_t)p[len - 1] << 8;
+	}
+	return sum;
+}
+
+static uint16_t
+inject_csum_fold(uint32_t sum)
+{
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+	return (uint16_t)sum;
+}
+
+static uint16_t
+inject_get16(const uint8_t *p)
+{
+	return (uint16_t)p[0] << 8 | p[1];
+}
+
+static void
+inject_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+/*
+ * Parse the frame and calculate its IPv4 and TCP/UDP checksums.
+ *
+ * Return length of headers up to the end of L4 header, or of L3
+ * header if L4 is neither TCP nor UDP. 0 is returned if the frame is
+ * not IP.
+ */
+static uint32_t
+inject_template_parse(struct inject_template *t, uint8_t *p, uint32_t len)
+{
+	uint32_t off = 14, l3len, l4len, hdr_len, sum = 0;
+	uint16_t type;
+	int proto;
+
+	if (len < off) {
+		return 0;
+	}
+
+	for (type = inject_get16(p + 12); type == 0x8100 || type == 0x88a8; off += 4) {
+		if (len < off + 4) {
+			return 0;
+		}
+		type = inject_get16(p + off + 2);
+	}
+
+	t->l3_off = off;
+	if (type == 0x0800) {
+		uint32_t ihl;
+
+		if (len < off + 20 || (ihl = (p[off] & 0xf) * 4) < 20 ||
+				len < off + ihl) {
+			return 0;
+		}
+
+		t->ipv4 = 1;
+		t->l3_end = off + ihl;
+		t->addr_off = off + 12;
+		t->addr_end = off + 20;
+		t->l3_csum_off = off + 10;
+		inject_put16(p + off + 10, 0);
+		inject_put16(p + off + 10, ~inject_csum_fold(inject_csum_add(0, p + off, ihl)));
+
+		proto = p[off + 9];
+		l3len = inject_get16(p + off + 2);
+		if (l3len < ihl || len < off + l3len ||
+				((p[off + 6] & 0x1f) | p[off + 7]) != 0) {
+			return off + ihl;
+		}
+		l4len = l3len - ihl;
+		hdr_len = off + ihl;
+		sum = inject_csum_add(0, p + off + 12, 8);
+	} else if (type == 0x86dd) {
+		if (len < off + 40) {
+			return 0;
+		}
+
+		t->l3_end = off + 40;
+		t->addr_off = off + 8;
+		t->addr_end = off + 40;
+		proto = p[off + 6];
+		l4len = inject_get16(p + off + 4);
+		hdr_len = off + 40;
+		if (len < hdr_len + l4len) {
+			return hdr_len;
+		}
+		sum = inject_csum_add(0, p + off + 8, 32);
+	} else {
+		return 0;
+	}
+
+	if (proto == 6 && l4len >= 20 && (p[hdr_len + 12] >> 4) >= 5 &&
+			(p[hdr_len + 12] >> 4) * 4 <= l4len) {
+		t->l4_csum_off = hdr_len + 16;
+		t->l4_off = hdr_len;
+		hdr_len += (p[hdr_len + 12] >> 4) * 4;
+	} else if (proto == 17 && l4len >= 8) {
+		t->l4_off = hdr_len;
+		t->udp = 1;
+		hdr_len += 8;
+		// UDP checksum is optional for IPv4
+		if (t->ipv4 && inject_get16(p + t->l4_off + 6) == 0) {
+			return hdr_len;
+		}
+		t->l4_csum_off = t->l4_off + 6;
+	} else {
+		return hdr_len;
+	}
+
+	sum += proto + (l4len >> 16) + (l4len & 0xffff);
+	inject_put16(p + t->l4_csum_off, 0);
+	sum = ~inject_csum_fold(inject_csum_add(sum, p + t->l4_off, l4len)) & 0xffff;
+	if (sum == 0 && t->udp) {
+		sum = 0xffff;
+	}
+	inject_put16(p + t->l4_csum_off, sum);
+	return hdr_len;
+}
+
+/*
+ * Allocate template out of the frame of len bytes.
+ *
+ * Return NULL with errno set: EINVAL if the frame is not an IP packet
+ * or headers are too long, ENOMEM.
+ */
+static struct inject_template *
+inject_template_alloc(const void *frame, uint32_t len)
+{
+	struct inject_template *t;
+	uint8_t *p;
+	uint32_t hdr_len;
+
+	if ((t = calloc(1, sizeof(*t))) == NULL || (p = malloc(len)) == NULL) {
+		free(t);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memcpy(p, frame, len);
+	hdr_len = inject_template_parse(t, p, len);
+	if (hdr_len == 0 || hdr_len > INJECT_TEMPLATE_HDR_MAX) {
+		free(p);
+		free(t);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	memcpy(t->base, p, hdr_len);
+	t->hdr_len = hdr_len;
+	t->payload_len = len - hdr_len;
+	memmove(p, p + hdr_len, t->payload_len);
+	t->payload = p;
+	return t;
+}
+
+static void
+inject_template_free(struct inject_template *t)
+{
+	free(t->payload);
+	free(t);
+}
+
+/*
+ * Add varied field. Fields may not overlap the checksums.
+ */
+static int
+inject_template_add_field(struct inject_template *t, int off, int size,
+		uint32_t base, uint32_t step, uint32_t count)
+{
+	struct inject_field *f;
+	int end = off + size;
+
+	if (t->nfields >= INJECT_TEMPLATE_FIELDS || off < 0 ||
+			(size != 1 && size != 2 && size != 4) || end > (int)t->hdr_len) {
+		return EINVAL;
+	}
+
+	if ((t->l3_csum_off && off < t->l3_csum_off + 2 && end > t->l3_csum_off) ||
+			(t->l4_csum_off && off < t->l4_csum_off + 2 && end > t->l4_csum_off)) {
+		return EINVAL;
+	}
+
+	f = &t->fields[t->nfields++];
+	f->off = off;
+	f->size = size;
+	f->base = base;
+	f->step = step;
+	f->count = count;
+	f->csum = 0;
+	if (t->ipv4 && off < t->l3_end && end > t->l3_off) {
+		f->csum |= INJECT_CSUM_L3;
+	}
+	if (t->l4_csum_off && (end > t->l4_off || (off < t->addr_end && end > t->addr_off))) {
+		f->csum |= INJECT_CSUM_L4;
+	}
+	return 0;
+}
+
+/*
+ * Return non-0 if 16-bit word at off is covered by IPv4 header
+ * checksum.
+ */
+static int
+inject_csum_l3_word(const struct inject_template *t, int off)
+{
+	return off >= t->l3_off && off < t->l3_end;
+}
+
+/*
+ * Return non-0 if 16-bit word at off is covered by TCP/UDP checksum.
+ */
+static int
+inject_csum_l4_word(const struct inject_template *t, int off)
+{
+	return off >= t->l4_off || (off >= t->addr_off && off < t->addr_end);
+}
+
+/*
+ * Incrementally update checksum at csum_off after 16-bit word changed
+ * from old to new (RFC 1624).
+ */
+static void
+inject_csum_update(uint8_t *p, int csum_off, uint16_t old, uint16_t new,
+		int udp)
+{
+	uint32_t sum = (uint16_t)~inject_get16(p + csum_off);
+	uint16_t csum;
+
+	sum += (uint16_t)~old;
+	sum += new;
+	csum = ~inject_csum_fold(sum);
+	inject_put16(p + csum_off, csum == 0 && udp ? 0xffff : csum);
+}
+
+/*
+ * Build header of the packet with sequence number seq.
+ */
+static void
+inject_template_build(struct inject_template *t, uint64_t seq)
+{
+	int i, j;
+
+	memcpy(t->hdr, t->base, t->hdr_len);
+	for (i = 0; i < t->nfields; i++) {
+		struct inject_field *f = &t->fields[i];
+		uint32_t v = f->base + (uint32_t)(f->count ? seq % f->count : seq) * f->step;
+		// checksum words are aligned to L3 header
+		int w0 = f->off - ((f->off - t->l3_off) & 1);
+		int w1 = f->off + f->size + ((f->off + f->size - t->l3_off) & 1);
+		uint16_t old[3];
+
+		for (j = w0; j < w1; j += 2) {
+			old[(j - w0) / 2] = inject_get16(t->hdr + j);
+		}
+
+		for (j = f->size - 1; j >= 0; j--, v >>= 8) {
+			t->hdr[f->off + j] = v;
+		}
+
+		for (j = w0; j < w1; j += 2) {
+			uint16_t new = inject_get16(t->hdr + j);
+			// a field may straddle headers
+			if ((f->csum & INJECT_CSUM_L3) && inject_csum_l3_word(t, j)) {
+				inject_csum_update(t->hdr, t->l3_csum_off, old[(j - w0) / 2], new, 0);
+			}
+			if ((f->csum & INJECT_CSUM_L4) && inject_csum_l4_word(t, j)) {
+				inject_csum_update(t->hdr, t->l4_csum_off, old[(j - w0) / 2], new, t->udp);
+			}
+		}
+	}
+}
+
+/*
+ * Send npkts packets of the template with sequence numbers starting
+ * from seq. If delay_ns is not 0, packets are scheduled with the
+ * delay. Returns the number of sent packets and the first error.
+ */
+static struct compound_int
+inject_template_send(snf_inject_t inj, int timeout_ms, int flags,
+		struct inject_template *t, uint64_t seq, int npkts,
+		uint64_t delay_ns)
+{
+	struct compound_int out;
+	struct snf_pkt_fragment frags[2];
+	int i, nfrags = t->payload_len > 0 ? 2 : 1;
+	uint32_t len = t->hdr_len + t->payload_len;
+
+	frags[0].ptr = t->hdr;
+	frags[0].length = t->hdr_len;
+	frags[1].ptr = t->payload;
+	frags[1].length = t->payload_len;
+
+	out.rc = 0;
+	for (i = 0; i < npkts; i++) {
+		inject_template_build(t, seq + i);
+		out.rc = delay_ns == 0 ?
+			snf_inject_send_v(inj, timeout_ms, flags, frags, nfrags, len) :
+			snf_inject_sched_v(inj, timeout_ms, flags, frags, nfrags, len, delay_ns);
+		if (out.rc != 0) {
+			break;
+		}
+	}
+
+	out.i[0] = i;
+	return out;
+}
+
+#endif /* _INJECT_TEMPLATE_H_ */
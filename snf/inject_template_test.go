@@ -0,0 +1,177 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which can be
+// found in the LICENSE file in the root of the source tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"testing"
+)
+
+// tmplFrame crafts Ethernet frame of IPv4 or IPv6 packet carrying TCP
+// or UDP segment with some payload. Checksums are left bogus.
+func tmplFrame(ipv6 bool, proto byte) []byte {
+	be := binary.BigEndian
+	l4len := 8 + 21
+	if proto == 6 {
+		l4len = 20 + 21
+	}
+
+	var data []byte
+	var l4 []byte
+	if ipv6 {
+		data = make([]byte, 14+40+l4len)
+		be.PutUint16(data[12:], 0x86dd)
+		ip := data[14:]
+		ip[0] = 0x60
+		be.PutUint16(ip[4:], uint16(l4len))
+		ip[6] = proto
+		ip[7] = 64
+		for i := 8; i < 40; i++ {
+			ip[i] = byte(i * 37)
+		}
+		l4 = ip[40:]
+	} else {
+		data = make([]byte, 14+20+l4len)
+		be.PutUint16(data[12:], 0x0800)
+		ip := data[14:]
+		ip[0] = 0x45
+		be.PutUint16(ip[2:], uint16(20+l4len))
+		be.PutUint16(ip[4:], 0xfffe)
+		ip[8] = 64
+		ip[9] = proto
+		be.PutUint16(ip[10:], 0xdead)
+		copy(ip[12:], []byte{10, 0, 0xff, 0xfe, 192, 168, 0xff, 0xff})
+		l4 = ip[20:]
+	}
+
+	be.PutUint16(l4[0:], 0xfff0)
+	be.PutUint16(l4[2:], 80)
+	if proto == 6 {
+		be.PutUint32(l4[4:], 0xfffffff0)
+		l4[12] = 0x50
+		be.PutUint16(l4[16:], 0xbeef)
+	} else {
+		be.PutUint16(l4[4:], uint16(l4len))
+		be.PutUint16(l4[6:], 0xbeef)
+	}
+	for i := range l4[l4len-21:] {
+		l4[l4len-21+i] = byte(i * 13)
+	}
+	return data
+}
+
+func csumAdd(sum uint32, b []byte) uint32 {
+	for i := 0; i+1 < len(b); i += 2 {
+		sum += uint32(binary.BigEndian.Uint16(b[i:]))
+	}
+	if len(b)&1 != 0 {
+		sum += uint32(b[len(b)-1]) << 8
+	}
+	return sum
+}
+
+func csumFold(sum uint32) uint16 {
+	for sum>>16 != 0 {
+		sum = sum&0xffff + sum>>16
+	}
+	return uint16(sum)
+}
+
+// checkCsums recomputes checksums of the frame and reports if they
+// are valid.
+func checkCsums(t *testing.T, seq uint64, data []byte) {
+	t.Helper()
+	be := binary.BigEndian
+
+	var pseudo uint32
+	var proto byte
+	var l4 []byte
+	if be.Uint16(data[12:]) == 0x0800 {
+		ip := data[14:34]
+		if s := csumFold(csumAdd(0, ip)); s != 0xffff {
+			t.Errorf("seq %d: bad IPv4 checksum, sum %#x", seq, s)
+		}
+		proto, l4 = ip[9], data[34:]
+		pseudo = csumAdd(0, ip[12:20])
+	} else {
+		ip := data[14:54]
+		proto, l4 = ip[6], data[54:]
+		pseudo = csumAdd(0, ip[8:40])
+	}
+
+	pseudo += uint32(proto) + uint32(len(l4))
+	if s := csumFold(csumAdd(pseudo, l4)); s != 0xffff {
+		t.Errorf("seq %d: bad L4 checksum, sum %#x", seq, s)
+	}
+}
+
+func TestInjectTemplateCsum(t *testing.T) {
+	type field struct{ off, size int }
+	tests := []struct {
+		name   string
+		ipv6   bool
+		proto  byte
+		fields []field
+	}{
+		// IPv4 addresses at 26-33, L4 at 34
+		{"IPv4/UDP", false, 17, []field{{18, 2}, {26, 4}, {30, 4}, {34, 2}, {36, 2}}},
+		{"IPv4/TCP", false, 6, []field{{18, 2}, {28, 4}, {38, 4}, {42, 4}}},
+		// fields straddling addresses and other headers
+		{"IPv4 addr/port", false, 17, []field{{33, 2}, {29, 2}}},
+		{"IPv4 addr/odd", false, 6, []field{{27, 4}, {31, 1}, {35, 2}}},
+		// IPv6 addresses at 22-53, L4 at 54
+		{"IPv6/UDP", true, 17, []field{{34, 4}, {50, 4}, {54, 2}, {56, 2}}},
+		{"IPv6/TCP", true, 6, []field{{24, 4}, {50, 4}, {58, 4}}},
+		{"IPv6 addr/port", true, 17, []field{{53, 2}, {21, 2}, {45, 1}}},
+	}
+
+	for _, test := range tests {
+		tmpl, err := NewInjectTemplate(tmplFrame(test.ipv6, test.proto))
+		if err != nil {
+			t.Fatal(test.name, err)
+		}
+
+		for i, f := range test.fields {
+			if err := tmpl.AddField(f.off, f.size, uint32(i)*0x01010101, 0x00ff00ff+uint32(i), 0); err != nil {
+				t.Fatal(test.name, f, err)
+			}
+		}
+
+		for seq := uint64(0); seq < 1000; seq++ {
+			checkCsums(t, seq, tmpl.packet(seq))
+		}
+		tmpl.Free()
+	}
+}
+
+func TestInjectTemplateVary(t *testing.T) {
+	for _, ipv6 := range []bool{false, true} {
+		for _, proto := range []byte{6, 17} {
+			tmpl, err := NewInjectTemplate(tmplFrame(ipv6, proto))
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			fields := []int{TmplSrcIP, TmplDstIP, TmplSrcPort, TmplDstPort}
+			if !ipv6 {
+				fields = append(fields, TmplIPv4ID)
+			}
+			if proto == 6 {
+				fields = append(fields, TmplTCPSeq)
+			}
+			for i, f := range fields {
+				if err := tmpl.Vary(f, 0, uint32(i+1), 0); err != nil {
+					t.Fatal(ipv6, proto, f, err)
+				}
+			}
+
+			for seq := uint64(0); seq < 70000; seq += 7 {
+				checkCsums(t, seq, tmpl.packet(seq))
+			}
+			tmpl.Free()
+		}
+	}
+}
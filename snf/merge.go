@@ -0,0 +1,193 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"syscall"
+	"time"
+)
+
+// Merger merges packets from several RingReaders into a single stream
+// ordered by packet timestamps.
+//
+// Merger keeps the head packet of every reader in a min-heap and
+// emits the earliest one if either every reader has a head packet or
+// the earliest packet is older than the reorder window. The window is
+// measured against both the latest received packet timestamp and the
+// host clock, so the NIC timestamps are supposed to be synchronized
+// with the host. Packets arriving later than the window may be
+// emitted out of order.
+type Merger struct {
+	readers []*RingReader
+	window  int64
+
+	// min-heap of indices of readers with head packets
+	heap []int
+	has  []bool
+
+	// reader of the last emitted packet
+	last int
+
+	// latest timestamp of head packets
+	maxTs int64
+
+	err error
+}
+
+// NewMerger creates Merger over readers with specified reorder window.
+// The readers should have short timeout since the readers with no
+// packets get polled in order to fill the heap.
+func NewMerger(window time.Duration, readers ...*RingReader) *Merger {
+	return &Merger{
+		readers: readers,
+		window:  window.Nanoseconds(),
+		heap:    make([]int, 0, len(readers)),
+		has:     make([]bool, len(readers)),
+		last:    -1,
+	}
+}
+
+func (m *Merger) ts(i int) int64 {
+	return m.readers[i].req().Timestamp()
+}
+
+func (m *Merger) less(a, b int) bool {
+	return m.ts(m.heap[a]) < m.ts(m.heap[b])
+}
+
+func (m *Merger) push(i int) {
+	m.heap = append(m.heap, i)
+	for j := len(m.heap) - 1; j > 0; {
+		parent := (j - 1) / 2
+		if !m.less(j, parent) {
+			break
+		}
+		m.heap[j], m.heap[parent] = m.heap[parent], m.heap[j]
+		j = parent
+	}
+}
+
+func (m *Merger) pop() int {
+	i := m.heap[0]
+	n := len(m.heap) - 1
+	m.heap[0] = m.heap[n]
+	m.heap = m.heap[:n]
+
+	for j := 0; ; {
+		min, l, r := j, 2*j+1, 2*j+2
+		if l < n && m.less(l, min) {
+			min = l
+		}
+		if r < n && m.less(r, min) {
+			min = r
+		}
+		if min == j {
+			break
+		}
+		m.heap[j], m.heap[min] = m.heap[min], m.heap[j]
+		j = min
+	}
+	return i
+}
+
+// fill advances reader i to its next packet and pushes it to the
+// heap.
+func (m *Merger) fill(i int) error {
+	rr := m.readers[i]
+	if !rr.Next() {
+		if err := rr.Err(); err != syscall.EAGAIN {
+			return err
+		}
+		return nil
+	}
+
+	m.has[i] = true
+	if ts := m.ts(i); ts > m.maxTs {
+		m.maxTs = ts
+	}
+	m.push(i)
+	return nil
+}
+
+// ready reports if the earliest packet may be emitted.
+func (m *Merger) ready() bool {
+	if len(m.heap) == 0 {
+		return false
+	}
+
+	if len(m.heap) == len(m.readers) {
+		return true
+	}
+
+	ts := m.ts(m.heap[0])
+	return ts+m.window <= m.maxTs || ts+m.window <= time.Now().UnixNano()
+}
+
+// Next gets next packet in timestamp order. If true, the operation is
+// a success, otherwise you should examine Err(). EAGAIN error means
+// no packet may be emitted yet.
+func (m *Merger) Next() bool {
+	if i := m.last; i >= 0 {
+		m.last = -1
+		if m.err = m.fill(i); m.err != nil {
+			return false
+		}
+	}
+
+	if !m.ready() {
+		for i, has := range m.has {
+			if !has {
+				if m.err = m.fill(i); m.err != nil {
+					return false
+				}
+			}
+		}
+
+		if !m.ready() {
+			m.err = syscall.EAGAIN
+			return false
+		}
+	}
+
+	m.last = m.pop()
+	m.has[m.last] = false
+	m.err = nil
+	return true
+}
+
+// LoopNext is similar to Next() method but this one loops if EAGAIN
+// is encountered.
+func (m *Merger) LoopNext() bool {
+	for !m.Next() {
+		if m.Err() != syscall.EAGAIN {
+			return false
+		}
+	}
+	return true
+}
+
+// Reader returns the reader of the current packet.
+func (m *Merger) Reader() *RingReader {
+	return m.readers[m.last]
+}
+
+// RecvReq returns current packet descriptor. See RingReader's
+// RecvReq().
+func (m *Merger) RecvReq() *RecvReq {
+	return m.Reader().RecvReq()
+}
+
+// Data gets current packet's data. See RingReader's Data().
+func (m *Merger) Data() []byte {
+	return m.Reader().Data()
+}
+
+// Err returns error which was encountered during the last Merger
+// operation.
+func (m *Merger) Err() error {
+	return m.err
+}
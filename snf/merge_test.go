@@ -0,0 +1,109 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"testing"
+	"time"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+func TestMergerOrder(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	// readers get packets in bursts of timestamps spread back in
+	// time so the bursts of different rings overlap
+	defer mockupEnv(t,
+		"SNF_NUM_RINGS", "3",
+		"SNF_DATARING_SIZE", "6",
+		"SNF_MOCKUP_PKT_LEN", "64",
+		"SNF_MOCKUP_PPS", "200000")()
+	assertFail(snf.Init() == nil)
+
+	h, err := snf.OpenHandle(0)
+	assertFail(err == nil, err)
+	defer h.Close()
+
+	var readers []*snf.RingReader
+	for i := 0; i < 3; i++ {
+		r, err := h.OpenRing()
+		assertFail(err == nil, err)
+		defer r.Close()
+
+		rr := snf.NewReader(r, 0, 64)
+		defer rr.Free()
+		readers = append(readers, rr)
+	}
+	assertFail(h.Start() == nil)
+
+	m := snf.NewMerger(50*time.Millisecond, readers...)
+	pkts := make(map[*snf.RingReader]int)
+	var last int64
+	for n := 0; n < 3*mockupRingPkts; n++ {
+		assertFail(m.LoopNext(), m.Err())
+
+		ts := m.RecvReq().Timestamp()
+		assertFail(ts >= last, n, ts, last)
+		last = ts
+		pkts[m.Reader()]++
+	}
+
+	// every reader contributed
+	for _, rr := range readers {
+		assertFail(pkts[rr] > mockupRingPkts/2, pkts[rr])
+	}
+}
+
+func TestMergerWindow(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	defer mockupEnv(t,
+		"SNF_NUM_RINGS", "1",
+		"SNF_DATARING_SIZE", "2",
+		"SNF_MOCKUP_PKT_LEN", "64",
+		"SNF_MOCKUP_PORTS", "2",
+		"SNF_MOCKUP_PPS", "10000")()
+	assertFail(snf.Init() == nil)
+
+	var handles []*snf.Handle
+	var readers []*snf.RingReader
+	for port := uint32(0); port < 2; port++ {
+		h, err := snf.OpenHandle(port)
+		assertFail(err == nil, err)
+		defer h.Close()
+		handles = append(handles, h)
+
+		r, err := h.OpenRing()
+		assertFail(err == nil, err)
+		defer r.Close()
+
+		rr := snf.NewReader(r, 0, 64)
+		defer rr.Free()
+		readers = append(readers, rr)
+	}
+
+	// the second port is not started so its reader has no packets
+	// and packets of the first one are held for the window
+	const window = 20 * time.Millisecond
+	assertFail(handles[0].Start() == nil)
+	m := snf.NewMerger(window, readers...)
+
+	start := time.Now()
+	var last int64
+	for n := 0; n < 500; n++ {
+		assertFail(m.LoopNext(), m.Err())
+		assertFail(m.Reader() == readers[0])
+
+		ts := m.RecvReq().Timestamp()
+		assertFail(ts >= last && ts+window.Nanoseconds() <= time.Now().UnixNano(), n, ts, last)
+		last = ts
+	}
+	assertFail(time.Since(start) >= window)
+}
@@ -0,0 +1,623 @@
+#ifndef _MOCKUP_H_
+#define _MOCKUP_H_
+
+/*
+ * Synthetic SNF implementation for snf_mockup build tag. Every ring
+ * generates its own stream of Ethernet/IPv4/UDP packets into the data
+ * ring following borrow-many-return-many model, and injection calls
+ * only count packets.
+ *
+ * The generator is configured via environment at snf_open():
+ *
+ *   SNF_NUM_RINGS       number of rings, default 1
+ *   SNF_DATARING_SIZE   data ring size for all rings, in megabytes if
+ *                       less than 1048576, default 256MB
+ *   SNF_MOCKUP_PORTS    number of ports, default 1
+ *   SNF_MOCKUP_PPS      packets per second per ring, 0 (default)
+ *                       means packets are always available
+ *   SNF_MOCKUP_PKT_LEN  packet length or range of lengths as in
+ *                       "64-1518", default 64
+ *   SNF_MOCKUP_BURST    maximum number of packets returned by a single
+ *                       receive call, 0 (default) means unlimited
+ *
+ * Since every cgo preamble including this file gets its own copy of
+ * the functions, all state is kept in the allocated handles.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MOCKUP_ALIGN 64
+#define MOCKUP_HDR_LEN 42
+#define MOCKUP_FLOWS 256
+#define MOCKUP_LINK_SPEED 10000000000ULL
+#define MOCKUP_MAX_RINGS 32
+#define MOCKUP_MAX_INJECT 16
+
+struct snf_ring {
+	struct snf_handle *h;
+	int id;
+	int open;
+
+	uint8_t *data;
+	uint64_t size;
+	uint64_t head; // bytes received
+	uint64_t tail; // bytes returned
+	uint32_t single; // length_data of packet received with snf_ring_recv
+
+	uint64_t gen; // packets generated
+	uint32_t seed;
+	struct snf_ring_stats stats;
+};
+
+struct snf_handle {
+	uint32_t portnum;
+	int num_rings;
+	int nopen;
+	int started;
+	uint64_t start_ns; // monotonic time of snf_start
+	uint64_t start_rt; // wall clock time of snf_start
+
+	// generator configuration
+	uint64_t pps;
+	uint32_t len_min;
+	uint32_t len_max;
+	int burst;
+
+	struct snf_ring rings[0];
+};
+
+struct snf_inject_handle {
+	int portnum;
+	struct snf_inject_stats stats;
+};
+
+struct mockup_ifaddrs {
+	struct snf_ifaddrs ifa;
+	char name[16];
+};
+
+static uint64_t mockup_env(const char *name, uint64_t def)
+{
+	const char *s = getenv(name);
+	return s != NULL && *s != '\0' ? strtoull(s, NULL, 0) : def;
+}
+
+static uint64_t mockup_clock(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void mockup_sleep(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000ULL,
+		.tv_nsec = ns % 1000000000ULL,
+	};
+	nanosleep(&ts, NULL);
+}
+
+static int mockup_ports(void)
+{
+	int n = (int)mockup_env("SNF_MOCKUP_PORTS", 1);
+	return n > 0 && n <= 32 ? n : 1;
+}
+
+static int snf_init(uint16_t api_version)
+{
+	return 0;
+}
+
+static int snf_set_app_id(int32_t id)
+{
+	return 0;
+}
+
+static int snf_getifaddrs(struct snf_ifaddrs **ifaddrs_o)
+{
+	int i, n = mockup_ports();
+	struct mockup_ifaddrs *ifa = calloc(n, sizeof(*ifa));
+
+	if (ifa == NULL)
+		return ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		snprintf(ifa[i].name, sizeof(ifa[i].name), "mock%d", i);
+		ifa[i].ifa.snf_ifa_next = i + 1 < n ? &ifa[i + 1].ifa : NULL;
+		ifa[i].ifa.snf_ifa_name = ifa[i].name;
+		ifa[i].ifa.snf_ifa_portnum = i;
+		ifa[i].ifa.snf_ifa_maxrings = MOCKUP_MAX_RINGS;
+		ifa[i].ifa.snf_ifa_macaddr[0] = 0x02;
+		ifa[i].ifa.snf_ifa_macaddr[5] = i;
+		ifa[i].ifa.snf_ifa_maxinject = MOCKUP_MAX_INJECT;
+		ifa[i].ifa.snf_ifa_link_state = SNF_LINK_UP;
+		ifa[i].ifa.snf_ifa_link_speed = MOCKUP_LINK_SPEED;
+	}
+
+	*ifaddrs_o = &ifa[0].ifa;
+	return 0;
+}
+
+static void snf_freeifaddrs(struct snf_ifaddrs *ifaddrs)
+{
+	free(ifaddrs);
+}
+
+static int snf_getportmask_valid(uint32_t * mask_o, int *cnt_o)
+{
+	int n = mockup_ports();
+	*mask_o = n < 32 ? (1U << n) - 1 : ~0U;
+	*cnt_o = n;
+	return 0;
+}
+
+static int snf_getportmask_linkup(uint32_t * mask_o, int *cnt_o)
+{
+	return snf_getportmask_valid(mask_o, cnt_o);
+}
+
+static int snf_open(uint32_t portnum,
+		    int num_rings,
+		    const struct snf_rss_params *rss_params,
+		    int64_t dataring_sz, int flags, snf_handle_t * devhandle)
+{
+	struct snf_handle *h;
+	uint64_t size;
+	int i, ports = mockup_ports();
+	char *len;
+
+	if (flags > 0 && (flags & SNF_F_AGGREGATE_PORTMASK)) {
+		if ((portnum & ((1ULL << ports) - 1)) == 0)
+			return ENODEV;
+		portnum = __builtin_ctz(portnum);
+	} else if (portnum == (uint32_t)-1) {
+		portnum = 0;
+	} else if (portnum >= (uint32_t)ports) {
+		return ENODEV;
+	}
+
+	if (num_rings <= 0)
+		num_rings = (int)mockup_env("SNF_NUM_RINGS", 1);
+	if (num_rings <= 0 || num_rings > MOCKUP_MAX_RINGS)
+		return EINVAL;
+
+	if (dataring_sz <= 0)
+		dataring_sz = (int64_t)mockup_env("SNF_DATARING_SIZE", 256);
+	if (dataring_sz < 1048576)
+		dataring_sz <<= 20;
+
+	// per ring size aligned to 2MB
+	size = ((uint64_t)dataring_sz / num_rings) & ~((2ULL << 20) - 1);
+	if (size == 0)
+		return E2BIG;
+
+	h = calloc(1, sizeof(*h) + num_rings * sizeof(h->rings[0]));
+	if (h == NULL)
+		return ENOMEM;
+
+	h->portnum = portnum;
+	h->num_rings = num_rings;
+	h->pps = mockup_env("SNF_MOCKUP_PPS", 0);
+	h->burst = (int)mockup_env("SNF_MOCKUP_BURST", 0);
+	h->len_min = h->len_max = 64;
+	if ((len = getenv("SNF_MOCKUP_PKT_LEN")) != NULL && *len != '\0') {
+		char *end;
+		h->len_min = h->len_max = strtoul(len, &end, 0);
+		if (*end == '-')
+			h->len_max = strtoul(end + 1, NULL, 0);
+	}
+
+	if (h->len_min < MOCKUP_HDR_LEN)
+		h->len_min = MOCKUP_HDR_LEN;
+	if (h->len_max < h->len_min)
+		h->len_max = h->len_min;
+	if (h->len_max > 65535)
+		h->len_max = 65535;
+
+	for (i = 0; i < num_rings; i++) {
+		h->rings[i].h = h;
+		h->rings[i].id = i;
+		h->rings[i].size = size;
+		h->rings[i].seed = i + 1;
+	}
+
+	*devhandle = h;
+	return 0;
+}
+
+static int snf_open_defaults(uint32_t portnum, snf_handle_t * devhandle)
+{
+	return snf_open(portnum, 0, NULL, 0, -1, devhandle);
+}
+
+static int snf_start(snf_handle_t devhandle)
+{
+	devhandle->start_ns = mockup_clock(CLOCK_MONOTONIC);
+	devhandle->start_rt = mockup_clock(CLOCK_REALTIME);
+	__atomic_store_n(&devhandle->started, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int snf_stop(snf_handle_t devhandle)
+{
+	__atomic_store_n(&devhandle->started, 0, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int snf_get_link_state(snf_handle_t devhandle,
+			      enum snf_link_state *state)
+{
+	*state = SNF_LINK_UP;
+	return 0;
+}
+
+static int snf_get_timesource_state(snf_handle_t devhandle,
+				    enum snf_timesource_state *state)
+{
+	*state = SNF_TIMESOURCE_LOCAL;
+	return 0;
+}
+
+static int snf_get_link_speed(snf_handle_t devhandle, uint64_t * speed)
+{
+	*speed = MOCKUP_LINK_SPEED;
+	return 0;
+}
+
+static int snf_close(snf_handle_t devhandle)
+{
+	int i;
+
+	if (__atomic_load_n(&devhandle->nopen, __ATOMIC_ACQUIRE) > 0)
+		return EBUSY;
+
+	for (i = 0; i < devhandle->num_rings; i++)
+		free(devhandle->rings[i].data);
+	free(devhandle);
+	return 0;
+}
+
+static int snf_ring_open_id(snf_handle_t devhandle, int ring_id,
+			    snf_ring_t * ringh)
+{
+	struct snf_ring *r;
+	void *data;
+	int i;
+
+	if (ring_id < 0) {
+		for (i = 0; i < devhandle->num_rings; i++)
+			if (snf_ring_open_id(devhandle, i, ringh) == 0)
+				return 0;
+		return EBUSY;
+	}
+
+	if (ring_id >= devhandle->num_rings)
+		return EINVAL;
+
+	r = &devhandle->rings[ring_id];
+	if (__atomic_exchange_n(&r->open, 1, __ATOMIC_ACQ_REL))
+		return EBUSY;
+
+	if (r->data == NULL) {
+		if (posix_memalign(&data, 2 << 20, r->size) != 0) {
+			__atomic_store_n(&r->open, 0, __ATOMIC_RELEASE);
+			return ENOMEM;
+		}
+		r->data = data;
+	}
+
+	r->head = r->tail = 0;
+	r->single = 0;
+	__atomic_fetch_add(&devhandle->nopen, 1, __ATOMIC_ACQ_REL);
+	*ringh = r;
+	return 0;
+}
+
+static int snf_ring_open(snf_handle_t devhandle, snf_ring_t * ringh)
+{
+	return snf_ring_open_id(devhandle, -1, ringh);
+}
+
+static int snf_ring_close(snf_ring_t ringh)
+{
+	ringh->tail = ringh->head;
+	__atomic_store_n(&ringh->open, 0, __ATOMIC_RELEASE);
+	__atomic_fetch_sub(&ringh->h->nopen, 1, __ATOMIC_ACQ_REL);
+	return 0;
+}
+
+static int snf_ring_portinfo_count(snf_ring_t ring, int *count)
+{
+	*count = 1;
+	return 0;
+}
+
+static int snf_ring_portinfo(snf_ring_t ring,
+			     struct snf_ring_portinfo *portinfo)
+{
+	portinfo->ring = ring;
+	portinfo->q_size = ring->size;
+	portinfo->portcnt = 1;
+	portinfo->portmask = 1U << ring->h->portnum;
+	portinfo->data_addr = (uintptr_t)ring->data;
+	portinfo->data_size = ring->size;
+	return 0;
+}
+
+static int snf_ring_recv_qinfo(snf_ring_t ring, struct snf_ring_qinfo *qi)
+{
+	qi->q_avail = 0;
+	qi->q_borrowed = ring->head - ring->tail;
+	qi->q_free = ring->size - (ring->head - ring->tail);
+	return 0;
+}
+
+/*
+ * Write synthetic Ethernet/IPv4/UDP headers of the packet. The flow is
+ * selected by source UDP port. IP checksum is not calculated.
+ */
+static void mockup_fill(uint8_t *p, uint32_t len, uint32_t flow)
+{
+	static const uint8_t hdr[MOCKUP_HDR_LEN] = {
+		// Ethernet
+		0x02, 0x00, 0x00, 0x00, 0x00, 0x02,
+		0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+		0x08, 0x00,
+		// IPv4
+		0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00,
+		0x40, 0x11, 0x00, 0x00,
+		10, 0, 0, 1,
+		10, 0, 0, 2,
+		// UDP
+		0x00, 0x00, 0x04, 0xd2, 0x00, 0x00, 0x00, 0x00,
+	};
+	uint32_t iplen = len - 14, udplen = len - 34;
+	uint16_t sport = 1024 + flow;
+
+	memcpy(p, hdr, sizeof(hdr));
+	p[16] = iplen >> 8;
+	p[17] = iplen;
+	p[34] = sport >> 8;
+	p[35] = sport;
+	p[38] = udplen >> 8;
+	p[39] = udplen;
+}
+
+static uint32_t mockup_len(struct snf_ring *r)
+{
+	struct snf_handle *h = r->h;
+
+	if (h->len_min == h->len_max)
+		return h->len_min;
+
+	r->seed = r->seed * 1103515245 + 12345;
+	return h->len_min + (r->seed >> 8) % (h->len_max - h->len_min + 1);
+}
+
+/*
+ * Return the number of packets due for generating, waiting at most
+ * timeout_ms for the next packet.
+ */
+static uint64_t mockup_due(struct snf_ring *r, int timeout_ms)
+{
+	struct snf_handle *h = r->h;
+	uint64_t now, due, max, wait, deadline = 0;
+
+	if (timeout_ms > 0)
+		deadline = mockup_clock(CLOCK_MONOTONIC) + timeout_ms * 1000000ULL;
+
+	for (;;) {
+		now = mockup_clock(CLOCK_MONOTONIC);
+		wait = 1000000ULL;
+
+		if (__atomic_load_n(&h->started, __ATOMIC_ACQUIRE)) {
+			if (h->pps == 0)
+				return (uint64_t)-1;
+
+			now -= h->start_ns;
+			due = (uint64_t)((__uint128_t)now * h->pps / 1000000000ULL);
+			due = due > r->gen ? due - r->gen : 0;
+
+			// packets not fitting into the ring are dropped
+			max = (r->size - (r->head - r->tail)) /
+			    ((h->len_max + MOCKUP_ALIGN - 1) & ~(MOCKUP_ALIGN - 1));
+			if (due > max) {
+				r->stats.ring_pkt_overflow += due - max;
+				r->stats.nic_pkt_recv += due - max;
+				r->gen += due - max;
+				due = max;
+			}
+
+			if (due > 0)
+				return due;
+
+			wait = (uint64_t)((__uint128_t)(r->gen + 1) *
+			    1000000000ULL / h->pps) - now + 1;
+			now += h->start_ns;
+		}
+
+		if (timeout_ms == 0 || (timeout_ms > 0 && now >= deadline))
+			return 0;
+
+		if (timeout_ms > 0 && now + wait > deadline)
+			wait = deadline - now;
+		mockup_sleep(wait);
+	}
+}
+
+static int snf_ring_recv_many(snf_ring_t ring, int timeout_ms,
+			      struct snf_recv_req *req_vector, int nreq_in,
+			      int *nreq_out, struct snf_ring_qinfo *qinfo)
+{
+	struct snf_handle *h = ring->h;
+	uint64_t due, ts;
+	int i, n = nreq_in;
+
+	if (h->burst > 0 && n > h->burst)
+		n = h->burst;
+
+	due = mockup_due(ring, timeout_ms);
+	if ((uint64_t)n > due)
+		n = (int)due;
+
+	ts = mockup_clock(CLOCK_REALTIME);
+	for (i = 0; i < n; i++) {
+		struct snf_recv_req *req = &req_vector[i];
+		uint32_t len = mockup_len(ring);
+		uint32_t ld = (len + MOCKUP_ALIGN - 1) & ~(MOCKUP_ALIGN - 1);
+		uint64_t pos = ring->head % ring->size;
+		uint32_t pad = pos + ld > ring->size ? ring->size - pos : 0;
+		uint32_t flow = ring->gen % MOCKUP_FLOWS;
+
+		if (ring->head + pad + ld - ring->tail > ring->size)
+			break;
+
+		req->pkt_addr = ring->data + (pos + pad) % ring->size;
+		req->length = len;
+		req->length_data = pad + ld;
+		// paced packets are stamped by their schedule so that
+		// timestamps don't depend on when the ring is polled
+		req->timestamp = h->pps ? h->start_rt +
+		    (uint64_t)((__uint128_t)(ring->gen + 1) * 1000000000ULL / h->pps) :
+		    ts + i;
+		req->portnum = h->portnum;
+		req->hw_hash = flow * 2654435761U;
+		mockup_fill(req->pkt_addr, len, flow);
+
+		ring->head += pad + ld;
+		ring->gen++;
+		ring->stats.ring_pkt_recv++;
+		ring->stats.nic_pkt_recv++;
+		ring->stats.nic_bytes_recv += (len + 12 + 15) & ~15;
+	}
+
+	*nreq_out = i;
+	if (qinfo != NULL) {
+		snf_ring_recv_qinfo(ring, qinfo);
+		if (h->pps && due > (uint64_t)i)
+			qinfo->q_avail = (due - i) * h->len_min;
+	}
+
+	return i > 0 ? 0 : EAGAIN;
+}
+
+static int snf_ring_return_many(snf_ring_t ring, uint32_t data_qlen,
+				struct snf_ring_qinfo *qinfo)
+{
+	if (data_qlen > ring->head - ring->tail)
+		return EINVAL;
+
+	ring->tail += data_qlen;
+	if (qinfo != NULL)
+		snf_ring_recv_qinfo(ring, qinfo);
+	return 0;
+}
+
+static int snf_ring_recv(snf_ring_t ringh, int timeout_ms,
+			 struct snf_recv_req *recv_req)
+{
+	int n, rc;
+
+	// previous packet is implicitly returned
+	ringh->tail += ringh->single;
+	ringh->single = 0;
+
+	if ((rc = snf_ring_recv_many(ringh, timeout_ms, recv_req, 1, &n,
+				     NULL)) == 0)
+		ringh->single = recv_req->length_data;
+	return rc;
+}
+
+static int snf_ring_getstats(snf_ring_t ringh, struct snf_ring_stats *stats)
+{
+	*stats = ringh->stats;
+	return 0;
+}
+
+static int snf_inject_open(int portnum, int flags, snf_inject_t * handle)
+{
+	struct snf_inject_handle *inj;
+
+	if (portnum < 0 || portnum >= mockup_ports())
+		return ENODEV;
+
+	if ((inj = calloc(1, sizeof(*inj))) == NULL)
+		return ENOMEM;
+
+	inj->portnum = portnum;
+	*handle = inj;
+	return 0;
+}
+
+static int snf_get_injection_speed(snf_inject_t devhandle, uint64_t * speed)
+{
+	*speed = MOCKUP_LINK_SPEED;
+	return 0;
+}
+
+static int snf_inject_send(snf_inject_t inj, int timeout_ms, int flags,
+			   const void *pkt, uint32_t length)
+{
+	inj->stats.inj_pkt_send++;
+	inj->stats.nic_pkt_send++;
+	inj->stats.nic_bytes_send += length;
+	return 0;
+}
+
+static int snf_inject_sched(snf_inject_t inj, int timeout_ms, int flags,
+			    const void *pkt, uint32_t length, uint64_t delay_ns)
+{
+	return snf_inject_send(inj, timeout_ms, flags, pkt, length);
+}
+
+static int snf_inject_send_v(snf_inject_t inj, int timeout_ms, int flags,
+			     struct snf_pkt_fragment *frags_vec, int nfrags,
+			     uint32_t length_hint)
+{
+	uint32_t length = 0;
+	int i;
+
+	for (i = 0; i < nfrags; i++)
+		length += frags_vec[i].length;
+
+	return snf_inject_send(inj, timeout_ms, flags, NULL, length);
+}
+
+static int snf_inject_sched_v(snf_inject_t inj, int timeout_ms, int flags,
+			      struct snf_pkt_fragment *frags_vec, int nfrags,
+			      uint32_t length_hint, uint64_t delay_ns)
+{
+	return snf_inject_send_v(inj, timeout_ms, flags, frags_vec, nfrags,
+				 length_hint);
+}
+
+static int snf_inject_close(snf_inject_t inj)
+{
+	free(inj);
+	return 0;
+}
+
+static int snf_inject_getstats(snf_inject_t inj, struct snf_inject_stats *stats)
+{
+	*stats = inj->stats;
+	return 0;
+}
+
+static int snf_netdev_reflect_enable(snf_handle_t hsnf,
+				     snf_netdev_reflect_t * handle)
+{
+	*handle = hsnf;
+	return 0;
+}
+
+static int snf_netdev_reflect(snf_netdev_reflect_t ref_dev, const void *pkt,
+			      uint32_t length)
+{
+	return 0;
+}
+
+#endif /* _MOCKUP_H_ */
@@ -0,0 +1,381 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+// +build snf_mockup
+
+package snf_test
+
+import (
+	"encoding/binary"
+	"io/ioutil"
+	"math"
+	"os"
+	"sync/atomic"
+	"syscall"
+	"testing"
+	"time"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+// mockupRingPkts is the capacity of a 2MB synthetic data ring in
+// 64-byte packets.
+const mockupRingPkts = (2 << 20) / 64
+
+// mockupEnv sets environment variables given as name-value pairs and
+// returns a func restoring their previous values. The synthetic SNF
+// reads its configuration when a handle is opened, so the variables
+// may be restored right after that.
+func mockupEnv(tb testing.TB, kv ...string) func() {
+	assertFail := newAssert(tb, true)
+
+	type prev struct {
+		name, value string
+		ok          bool
+	}
+	var saved []prev
+	restore := func() {
+		for i := len(saved) - 1; i >= 0; i-- {
+			if p := saved[i]; p.ok {
+				os.Setenv(p.name, p.value)
+			} else {
+				os.Unsetenv(p.name)
+			}
+		}
+	}
+
+	for i := 0; i+1 < len(kv); i += 2 {
+		value, ok := os.LookupEnv(kv[i])
+		saved = append(saved, prev{kv[i], value, ok})
+		if err := os.Setenv(kv[i], kv[i+1]); err != nil {
+			restore()
+			assertFail(false, err)
+		}
+	}
+	return restore
+}
+
+// mockupRing sets up synthetic ring with data ring of specified size
+// in megabytes and packets of specified length. The capture is
+// started.
+func mockupRing(tb testing.TB, dataring, pktLen string) (*snf.Ring, func()) {
+	assertFail := newAssert(tb, true)
+
+	defer mockupEnv(tb,
+		"SNF_NUM_RINGS", "1",
+		"SNF_DATARING_SIZE", dataring,
+		"SNF_MOCKUP_PKT_LEN", pktLen)()
+	assertFail(snf.Init() == nil)
+
+	h, err := snf.OpenHandle(0)
+	assertFail(err == nil, err)
+
+	r, err := h.OpenRing()
+	assertFail(err == nil, err)
+	assertFail(h.Start() == nil)
+
+	return r, func() {
+		r.Close()
+		h.Close()
+	}
+}
+
+// mockupReader sets up synthetic ring with mockupRing() and returns
+// RingReader on it.
+func mockupReader(tb testing.TB, dataring, pktLen string, timeout time.Duration, burst int) (*snf.RingReader, func()) {
+	r, teardown := mockupRing(tb, dataring, pktLen)
+	rr := snf.NewReader(r, timeout, burst)
+	return rr, func() {
+		rr.Free()
+		teardown()
+	}
+}
+
+// dropping invokes Next() until dropped() reports at least n packets
+// or the ring stalls.
+func dropping(t *testing.T, rr *snf.RingReader, n uint64, dropped func() uint64) {
+	assertFail := newAssert(t, true)
+
+	deadline := time.Now().Add(10 * time.Second)
+	for dropped() < n {
+		if !rr.Next() {
+			assertFail(rr.Err() == syscall.EAGAIN, rr.Err())
+		}
+		assertFail(time.Now().Before(deadline), "ring stalled after", dropped(), "packets")
+	}
+}
+
+// receiving checks that Next() yields n packets.
+func receiving(t *testing.T, rr *snf.RingReader, n int) {
+	assertFail := newAssert(t, true)
+
+	for i := 0; i < n; i++ {
+		assertFail(rr.Next(), "ring stalled after", i, "packets:", rr.Err())
+	}
+}
+
+func TestFilterDropAllBursts(t *testing.T) {
+	rr, teardown := mockupReader(t, "2", "64", 10*time.Millisecond, 256)
+	defer teardown()
+
+	// drop everything for several data rings' worth of packets
+	assertFail := newAssert(t, true)
+	assertFail(rr.SetBPF([]snf.BPFInstruction{{Code: 0x06, K: 0}}) == nil)
+	dropping(t, rr, 4*mockupRingPkts, rr.Filtered)
+
+	// burst dropped entirely should not hold ring data either
+	assertFail(rr.Free() == nil)
+	assertFail(rr.SetBPF(nil) == nil)
+	receiving(t, rr, 4*mockupRingPkts)
+}
+
+func TestSampleEvery(t *testing.T) {
+	rr, teardown := mockupReader(t, "2", "64", 10*time.Millisecond, 256)
+	defer teardown()
+
+	// most bursts are dropped entirely
+	rr.SampleEvery(1000)
+	dropping(t, rr, 4*mockupRingPkts, func() uint64 {
+		sampled, _ := rr.Sampled()
+		return sampled
+	})
+
+	rr.SampleEvery(0)
+	receiving(t, rr, 4*mockupRingPkts)
+}
+
+// bpfUDPDstPort returns program matching IPv4/UDP packets with no IP
+// options by destination port.
+func bpfUDPDstPort(port uint32) []snf.BPFInstruction {
+	return bpfUDPPortAt(36, port)
+}
+
+// bpfUDPPortAt returns program matching IPv4/UDP packets with no IP
+// options by port at offset off of the frame.
+func bpfUDPPortAt(off, port uint32) []snf.BPFInstruction {
+	return []snf.BPFInstruction{
+		{Code: 0x28, K: 12},                  // ldh [12]
+		{Code: 0x15, Jt: 0, Jf: 5, K: 0x800}, // jeq #0x800
+		{Code: 0x30, K: 23},                  // ldb [23]
+		{Code: 0x15, Jt: 0, Jf: 3, K: 17},    // jeq #17
+		{Code: 0x28, K: off},                 // ldh [off]
+		{Code: 0x15, Jt: 0, Jf: 1, K: port},  // jeq #port
+		{Code: 0x06, K: 0x40000},             // ret #262144
+		{Code: 0x06, K: 0},                   // ret #0
+	}
+}
+
+func TestSetBPF(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	rr, teardown := mockupReader(t, "2", "64", 10*time.Millisecond, 256)
+	defer teardown()
+
+	// synthetic packets are destined to port 1234
+	assertFail(rr.SetBPF(bpfUDPDstPort(1234)) == nil)
+	receiving(t, rr, 4*mockupRingPkts)
+	assertFail(rr.Filtered() == 0, rr.Filtered())
+
+	assertFail(rr.SetBPF(bpfUDPDstPort(4321)) == nil)
+	dropping(t, rr, 4*mockupRingPkts, rr.Filtered)
+
+	assertFail(rr.SetBPF(nil) == nil)
+	receiving(t, rr, 4*mockupRingPkts)
+}
+
+func TestRingPool(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	restore := mockupEnv(t, "SNF_MOCKUP_PKT_LEN", "64")
+	assertFail(snf.Init() == nil)
+
+	h, err := snf.OpenHandle(0, snf.HandlerOptNumRings(2),
+		snf.HandlerOptDataRingSize(8<<20))
+	restore()
+	assertFail(err == nil, err)
+	defer h.Close()
+
+	var pkts [2]uint64
+	pool, err := snf.NewRingPool(h, 2, func(id int, reqs []snf.RecvReq) {
+		atomic.AddUint64(&pkts[id], uint64(len(reqs)))
+	}, snf.PoolOptCPUs([]int{0}), snf.PoolOptReaderInit(func(id int, rr *snf.RingReader) {
+		rr.SampleEvery(2)
+	}))
+	assertFail(err == nil, err)
+	defer pool.Close()
+
+	pool.Start()
+	for _, rr := range pool.Readers() {
+		assertFail(rr != nil)
+	}
+	assertFail(h.Start() == nil)
+
+	deadline := time.Now().Add(10 * time.Second)
+	for atomic.LoadUint64(&pkts[0]) < 4*mockupRingPkts ||
+		atomic.LoadUint64(&pkts[1]) < 4*mockupRingPkts {
+		assertFail(time.Now().Before(deadline), "rings stalled")
+		time.Sleep(time.Millisecond)
+	}
+
+	pool.Stop()
+	assertFail(pool.Wait() == nil)
+	for _, rr := range pool.Readers() {
+		sampled, _ := rr.Sampled()
+		assertFail(sampled > 0)
+	}
+}
+
+func TestLatencyStatsShared(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	restore := mockupEnv(t, "SNF_MOCKUP_PKT_LEN", "64")
+	assertFail(snf.Init() == nil)
+
+	h, err := snf.OpenHandle(0, snf.HandlerOptNumRings(2),
+		snf.HandlerOptDataRingSize(4<<20))
+	restore()
+	assertFail(err == nil, err)
+	defer h.Close()
+
+	var stats snf.LatencyStats
+	var readers []*snf.RingReader
+	for i := 0; i < 2; i++ {
+		r, err := h.OpenRing()
+		assertFail(err == nil, err)
+		defer r.Close()
+
+		rr := snf.NewReader(r, time.Second, 64)
+		defer rr.Free()
+		rr.SetLatencyStats(&stats)
+		readers = append(readers, rr)
+	}
+	assertFail(h.Start() == nil)
+
+	done := make(chan error)
+	for _, rr := range readers {
+		go func(rr *snf.RingReader) {
+			for n := 0; n < mockupRingPkts; n++ {
+				if !rr.Next() {
+					done <- rr.Err()
+					return
+				}
+			}
+			done <- nil
+		}(rr)
+	}
+	for range readers {
+		assertFail(<-done == nil)
+	}
+
+	// first packet of every reader has no inter-arrival time
+	lat, ia := stats.Latency.Count(), stats.InterArrival.Count()
+	assertFail(lat >= 2*mockupRingPkts && ia == lat-2, lat, ia)
+}
+
+func TestStatsPoller(t *testing.T) {
+	assertFail := newAssert(t, true)
+
+	// packets not read in time overflow the ring
+	restore := mockupEnv(t, "SNF_MOCKUP_PPS", "1000000")
+	rr, teardown := mockupReader(t, "2", "64", time.Second, 256)
+	restore()
+	defer teardown()
+
+	inj, err := snf.OpenInjectHandle(0)
+	assertFail(err == nil, err)
+	defer inj.Close()
+	sender := snf.NewSender(inj, time.Second, 0)
+
+	p := snf.NewStatsPoller(time.Hour)
+	ri := p.AddRing(rr.Ring())
+	ii := p.AddInject(inj)
+
+	var s0, s1 snf.RingStatsSnapshot
+	var i0, i1 snf.InjectStatsSnapshot
+	p.Ring(ri, &s0)
+	p.Inject(ii, &i0)
+	assertFail(s0.Time.IsZero() && i0.Time.IsZero())
+
+	before := time.Now()
+	p.Poll()
+	p.Ring(ri, &s0)
+	p.Inject(ii, &i0)
+	assertFail(!s0.Time.Before(before) && !s0.Time.After(time.Now()), s0.Time)
+	assertFail(!i0.Time.Before(s0.Time), i0.Time)
+	assertFail(s0.Pps == 0 && s0.Bps == 0 && s0.DropRatio == 0, s0.Pps, s0.Bps, s0.DropRatio)
+	assertFail(i0.Pps == 0 && i0.Bps == 0, i0.Pps, i0.Bps)
+
+	time.Sleep(50 * time.Millisecond)
+	for n := 0; n < 10000; n++ {
+		assertFail(rr.Next(), rr.Err())
+	}
+	pkt := make([]byte, 100)
+	for n := 0; n < 1000; n++ {
+		assertFail(sender.Send(pkt) == nil)
+	}
+
+	p.Poll()
+	p.Ring(ri, &s1)
+	p.Inject(ii, &i1)
+	sec := s1.Time.Sub(s0.Time).Seconds()
+	assertFail(sec >= 0.05, sec)
+
+	near := func(got, want float64) bool {
+		return math.Abs(got-want) <= 1e-9*math.Abs(want)
+	}
+
+	recv := s1.RingPktRecv - s0.RingPktRecv
+	dropped := s1.RingPktOverflow - s0.RingPktOverflow
+	assertFail(recv >= 10000 && dropped > 0, recv, dropped)
+	assertFail(near(s1.Pps, float64(recv)/sec), s1.Pps, recv, sec)
+	assertFail(near(s1.Bps, float64(s1.NicBytesRecv-s0.NicBytesRecv)*8/sec), s1.Bps)
+	assertFail(near(s1.DropRatio, float64(dropped)/float64(recv+dropped)), s1.DropRatio)
+
+	sec = i1.Time.Sub(i0.Time).Seconds()
+	assertFail(i1.InjPktSend()-i0.InjPktSend() == 1000)
+	assertFail(near(i1.Pps, 1000/sec), i1.Pps, sec)
+	assertFail(near(i1.Bps, 1000*100*8/sec), i1.Bps, sec)
+}
+
+func TestReplayEmpty(t *testing.T) {
+	assertFail := newAssert(t, true)
+	assertFail(snf.Init() == nil)
+
+	f, err := ioutil.TempFile("", "snf-replay")
+	assertFail(err == nil, err)
+	defer os.Remove(f.Name())
+
+	// pcap file header only
+	hdr := make([]byte, 24)
+	binary.LittleEndian.PutUint32(hdr, 0xa1b2c3d4)
+	_, err = f.Write(hdr)
+	assertFail(err == nil, err)
+	assertFail(f.Close() == nil)
+
+	r, err := snf.OpenReplayer(f.Name())
+	assertFail(err == nil, err)
+	defer r.Close()
+	assertFail(r.Len() == 0)
+
+	h, err := snf.OpenInjectHandle(0)
+	assertFail(err == nil, err)
+	defer h.Close()
+
+	sent, err := r.Replay(snf.NewSender(h, time.Millisecond, 0), 0, 32)
+	assertFail(sent == 0 && err == nil, sent, err)
+}
+
+func TestReturnThreshold(t *testing.T) {
+	rr, teardown := mockupReader(t, "2", "64", 10*time.Millisecond, 256)
+	defer teardown()
+
+	rr.SetReturnThreshold(0, 16)
+	receiving(t, rr, 4*mockupRingPkts)
+
+	// partially returned bursts with dropped packets
+	rr.SampleEvery(3)
+	receiving(t, rr, 4*mockupRingPkts)
+}
@@ -0,0 +1,422 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"os"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// Capture file formats for PcapWriter.
+const (
+	// FormatPcap is the classic pcap format with nanosecond
+	// timestamps.
+	FormatPcap = iota
+	// FormatPcapNg is the pcapng format with nanosecond timestamps
+	// and an interface per SNF port.
+	FormatPcapNg
+)
+
+// alignment of buffers and writes for O_DIRECT
+const pcapAlign = 4096
+
+const (
+	pcapMagicNs  = 0xa1b23c4d
+	pcapLinkType = 1 // Ethernet
+
+	pcapngSHB    = 0x0a0d0d0a
+	pcapngIDB    = 0x00000001
+	pcapngEPB    = 0x00000006
+	pcapngBOM    = 0x1a2b3c4d
+	pcapngSHBLen = 28
+	pcapngIDBLen = 32
+	pcapngEPBLen = 32
+)
+
+// pcap writer options container
+type pcapOpts struct {
+	format  int
+	snapLen int
+	bufSize int
+	maxSize int64
+	maxDur  time.Duration
+	direct  bool
+}
+
+// PcapOption specifies an option for creating a PcapWriter.
+type PcapOption struct {
+	f func(*pcapOpts)
+}
+
+// PcapOptFormat specifies format of capture files, FormatPcap (the
+// default) or FormatPcapNg.
+func PcapOptFormat(format int) PcapOption {
+	return PcapOption{func(opts *pcapOpts) {
+		opts.format = format
+	}}
+}
+
+// PcapOptSnapLen specifies maximum number of bytes stored per packet.
+// Default is 65535.
+func PcapOptSnapLen(n int) PcapOption {
+	return PcapOption{func(opts *pcapOpts) {
+		opts.snapLen = n
+	}}
+}
+
+// PcapOptBufSize specifies size of each of two write buffers. It is
+// rounded up to 4096 bytes. Default is 4MB.
+func PcapOptBufSize(n int) PcapOption {
+	return PcapOption{func(opts *pcapOpts) {
+		opts.bufSize = n
+	}}
+}
+
+// PcapOptRotate specifies maximum size of a capture file in bytes and
+// maximum time span of packets in a capture file. Once any of the
+// limits is exceeded, the next file is started. Zero value disables
+// the corresponding limit.
+func PcapOptRotate(maxSize int64, maxDur time.Duration) PcapOption {
+	return PcapOption{func(opts *pcapOpts) {
+		opts.maxSize = maxSize
+		opts.maxDur = maxDur
+	}}
+}
+
+// PcapOptDirect specifies that capture files are opened with O_DIRECT
+// flag bypassing the page cache.
+func PcapOptDirect() PcapOption {
+	return PcapOption{func(opts *pcapOpts) {
+		opts.direct = true
+	}}
+}
+
+// pcapJob is a buffer queued for writing.
+type pcapJob struct {
+	buf   []byte
+	open  bool // open next file before writing
+	final bool // close file after writing
+}
+
+// PcapWriter writes bursts of packets into capture files. Packets are
+// copied into one of two large buffers while the other one is being
+// written to disk by a background goroutine.
+//
+// PcapWriter is not safe for concurrent use.
+type PcapWriter struct {
+	opts pcapOpts
+	name func(seq int) string
+
+	buf     []byte
+	free    chan []byte
+	jobs    chan pcapJob
+	done    chan struct{}
+	errMtx  sync.Mutex
+	err     error
+	started bool
+
+	// error of the background writer as of the last flush
+	flushErr error
+
+	// current file
+	open    bool
+	size    int64
+	firstTs int64
+	ifaces  map[uint32]uint32
+}
+
+// NewPcapWriter creates PcapWriter. name returns a file name for the
+// capture file with sequence number seq starting from 0.
+func NewPcapWriter(name func(seq int) string, options ...PcapOption) *PcapWriter {
+	w := &PcapWriter{
+		opts: pcapOpts{
+			format:  FormatPcap,
+			snapLen: 65535,
+			bufSize: 4 << 20,
+		},
+		name: name,
+		free: make(chan []byte, 2),
+		jobs: make(chan pcapJob, 2),
+		done: make(chan struct{}),
+	}
+
+	for _, opt := range options {
+		opt.f(&w.opts)
+	}
+
+	// buffer should fit the largest record along with the tail
+	// carried over in direct mode
+	if min := w.opts.snapLen + pcapngEPBLen + 2*pcapAlign; w.opts.bufSize < min {
+		w.opts.bufSize = min
+	}
+	w.opts.bufSize = (w.opts.bufSize + pcapAlign - 1) &^ (pcapAlign - 1)
+
+	w.buf = alignedBuf(w.opts.bufSize)
+	w.free <- alignedBuf(w.opts.bufSize)
+	go w.writer()
+	return w
+}
+
+func alignedBuf(size int) []byte {
+	b := make([]byte, size+pcapAlign)
+	off := int(-uintptr(unsafe.Pointer(&b[0])) & (pcapAlign - 1))
+	return b[off : off : off+size]
+}
+
+func (w *PcapWriter) setErr(err error) {
+	w.errMtx.Lock()
+	if w.err == nil {
+		w.err = err
+	}
+	w.errMtx.Unlock()
+}
+
+func (w *PcapWriter) getErr() error {
+	w.errMtx.Lock()
+	defer w.errMtx.Unlock()
+	return w.err
+}
+
+// writer writes queued buffers to files.
+func (w *PcapWriter) writer() {
+	defer close(w.done)
+
+	var f *os.File
+	seq := 0
+	for job := range w.jobs {
+		if job.open && w.getErr() == nil {
+			flags := os.O_WRONLY | os.O_CREATE | os.O_TRUNC
+			if w.opts.direct {
+				flags |= syscall.O_DIRECT
+			}
+			var err error
+			if f, err = os.OpenFile(w.name(seq), flags, 0644); err != nil {
+				w.setErr(err)
+				f = nil
+			}
+			seq++
+		}
+
+		if f != nil {
+			if err := w.writeJob(f, &job); err != nil {
+				w.setErr(err)
+			}
+			if job.final {
+				if err := f.Close(); err != nil {
+					w.setErr(err)
+				}
+				f = nil
+			}
+		}
+
+		w.free <- job.buf[:0]
+	}
+}
+
+func (w *PcapWriter) writeJob(f *os.File, job *pcapJob) error {
+	data := job.buf
+	if w.opts.direct && job.final {
+		// write aligned part directly, the rest through page
+		// cache
+		n := len(data) &^ (pcapAlign - 1)
+		if _, err := f.Write(data[:n]); err != nil {
+			return err
+		}
+		if err := clearDirect(f); err != nil {
+			return err
+		}
+		data = data[n:]
+	}
+
+	_, err := f.Write(data)
+	return err
+}
+
+func clearDirect(f *os.File) error {
+	fd := f.Fd()
+	flags, _, e := syscall.Syscall(syscall.SYS_FCNTL, fd, syscall.F_GETFL, 0)
+	if e != 0 {
+		return e
+	}
+	_, _, e = syscall.Syscall(syscall.SYS_FCNTL, fd, syscall.F_SETFL, flags&^syscall.O_DIRECT)
+	if e != 0 {
+		return e
+	}
+	return nil
+}
+
+// flush queues current buffer for writing and acquires the empty
+// one. In direct mode only the aligned part of the buffer is queued unless
+// final is set, the rest is carried over to the next buffer.
+func (w *PcapWriter) flush(final bool) {
+	job := pcapJob{buf: w.buf, open: !w.started, final: final}
+	w.started = !final
+
+	var tail []byte
+	if w.opts.direct && !final {
+		n := len(w.buf) &^ (pcapAlign - 1)
+		job.buf, tail = w.buf[:n], w.buf[n:]
+	}
+
+	next := <-w.free
+	w.buf = append(next, tail...)
+	w.jobs <- job
+	w.flushErr = w.getErr()
+}
+
+func (w *PcapWriter) reserve(n int) []byte {
+	if len(w.buf)+n > cap(w.buf) {
+		w.flush(false)
+	}
+
+	off := len(w.buf)
+	w.buf = w.buf[:off+n]
+	w.size += int64(n)
+	return w.buf[off:]
+}
+
+func (w *PcapWriter) startFile(ts int64) {
+	if w.open {
+		w.flush(true)
+	}
+
+	w.open = true
+	w.size = 0
+	w.firstTs = ts
+	w.ifaces = make(map[uint32]uint32)
+
+	snapLen := uint32(w.opts.snapLen)
+	le := binary.LittleEndian
+	if w.opts.format == FormatPcapNg {
+		b := w.reserve(pcapngSHBLen)
+		le.PutUint32(b[0:], pcapngSHB)
+		le.PutUint32(b[4:], pcapngSHBLen)
+		le.PutUint32(b[8:], pcapngBOM)
+		le.PutUint16(b[12:], 1)
+		le.PutUint16(b[14:], 0)
+		le.PutUint64(b[16:], ^uint64(0))
+		le.PutUint32(b[24:], pcapngSHBLen)
+		return
+	}
+
+	b := w.reserve(24)
+	le.PutUint32(b[0:], pcapMagicNs)
+	le.PutUint16(b[4:], 2)
+	le.PutUint16(b[6:], 4)
+	le.PutUint32(b[8:], 0)
+	le.PutUint32(b[12:], 0)
+	le.PutUint32(b[16:], snapLen)
+	le.PutUint32(b[20:], pcapLinkType)
+}
+
+// iface returns pcapng interface id of the port, writing interface
+// description block if needed.
+func (w *PcapWriter) iface(port uint32) uint32 {
+	if id, ok := w.ifaces[port]; ok {
+		return id
+	}
+
+	id := uint32(len(w.ifaces))
+	w.ifaces[port] = id
+
+	le := binary.LittleEndian
+	b := w.reserve(pcapngIDBLen)
+	le.PutUint32(b[0:], pcapngIDB)
+	le.PutUint32(b[4:], pcapngIDBLen)
+	le.PutUint16(b[8:], pcapLinkType)
+	le.PutUint16(b[10:], 0)
+	le.PutUint32(b[12:], uint32(w.opts.snapLen))
+	// if_tsresol: nanoseconds
+	le.PutUint16(b[16:], 9)
+	le.PutUint16(b[18:], 1)
+	b[20], b[21], b[22], b[23] = 9, 0, 0, 0
+	// opt_endofopt
+	le.PutUint32(b[24:], 0)
+	le.PutUint32(b[28:], pcapngIDBLen)
+	return id
+}
+
+func (w *PcapWriter) rotate(ts int64) bool {
+	if !w.open {
+		return true
+	}
+	if w.opts.maxSize > 0 && w.size >= w.opts.maxSize {
+		return true
+	}
+	return w.opts.maxDur > 0 && ts-w.firstTs >= w.opts.maxDur.Nanoseconds()
+}
+
+// WritePacket writes a packet into current capture file. Errors of
+// writing to disk are reported once the buffer holding the failed
+// write is recycled.
+func (w *PcapWriter) WritePacket(req *RecvReq) error {
+	ts := req.Timestamp()
+	if w.rotate(ts) {
+		w.startFile(ts)
+	}
+
+	data := req.Data()
+	orig := len(data)
+	if len(data) > w.opts.snapLen {
+		data = data[:w.opts.snapLen]
+	}
+
+	le := binary.LittleEndian
+	if w.opts.format == FormatPcapNg {
+		id := w.iface(uint32(req.portnum))
+		padded := (len(data) + 3) &^ 3
+		n := pcapngEPBLen + padded
+		b := w.reserve(n)
+		le.PutUint32(b[0:], pcapngEPB)
+		le.PutUint32(b[4:], uint32(n))
+		le.PutUint32(b[8:], id)
+		le.PutUint32(b[12:], uint32(uint64(ts)>>32))
+		le.PutUint32(b[16:], uint32(ts))
+		le.PutUint32(b[20:], uint32(len(data)))
+		le.PutUint32(b[24:], uint32(orig))
+		copy(b[28:], data)
+		for i := 28 + len(data); i < 28+padded; i++ {
+			b[i] = 0
+		}
+		le.PutUint32(b[n-4:], uint32(n))
+	} else {
+		b := w.reserve(16 + len(data))
+		le.PutUint32(b[0:], uint32(ts/1e9))
+		le.PutUint32(b[4:], uint32(ts%1e9))
+		le.PutUint32(b[8:], uint32(len(data)))
+		le.PutUint32(b[12:], uint32(orig))
+		copy(b[16:], data)
+	}
+
+	return w.flushErr
+}
+
+// WriteBurst writes a burst of packets, e.g. obtained with
+// RingReader's NextBatch(), into current capture file.
+func (w *PcapWriter) WriteBurst(reqs []RecvReq) error {
+	for i := range reqs {
+		if err := w.WritePacket(&reqs[i]); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Close writes all buffered packets, closes current capture file and
+// stops the background writer.
+func (w *PcapWriter) Close() error {
+	if w.open {
+		w.flush(true)
+	}
+	close(w.jobs)
+	<-w.done
+	return w.getErr()
+}
@@ -0,0 +1,209 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"unsafe"
+)
+
+// pcapRecord is a packet as stored in a capture file.
+type pcapRecord struct {
+	ts   int64
+	port uint32
+	orig int
+	data []byte
+}
+
+// pcapReqs returns n packets of various lengths received on 3 ports.
+func pcapReqs(n int) ([]RecvReq, []pcapRecord) {
+	reqs := make([]RecvReq, n)
+	recs := make([]pcapRecord, n)
+	for i := range reqs {
+		data := make([]byte, 60+i*37%1455)
+		for j := range data {
+			data[j] = byte(i + j)
+		}
+
+		req := &reqs[i]
+		req.pkt_addr = unsafe.Pointer(&data[0])
+		*(*uint32)(unsafe.Pointer(&req.length)) = uint32(len(data))
+		*(*uint32)(unsafe.Pointer(&req.length_data)) = uint32(len(data))
+		*(*uint64)(unsafe.Pointer(&req.timestamp)) = uint64(1e18 + i*12345)
+		*(*uint32)(unsafe.Pointer(&req.portnum)) = uint32(i % 3)
+		recs[i] = pcapRecord{req.Timestamp(), uint32(i % 3), len(data), data}
+	}
+	return reqs, recs
+}
+
+// parsePcap parses classic pcap file with nanosecond timestamps.
+func parsePcap(b []byte, snapLen int) ([]pcapRecord, error) {
+	le := binary.LittleEndian
+	if len(b) < 24 || le.Uint32(b) != pcapMagicNs || le.Uint32(b[16:]) != uint32(snapLen) ||
+		le.Uint32(b[20:]) != pcapLinkType {
+		return nil, fmt.Errorf("bad file header")
+	}
+
+	var recs []pcapRecord
+	for b = b[24:]; len(b) > 0; {
+		if len(b) < 16 {
+			return nil, fmt.Errorf("truncated record header")
+		}
+		caplen := int(le.Uint32(b[8:]))
+		if caplen > snapLen || len(b) < 16+caplen {
+			return nil, fmt.Errorf("bad record caplen %d", caplen)
+		}
+		ts := int64(le.Uint32(b))*1e9 + int64(le.Uint32(b[4:]))
+		recs = append(recs, pcapRecord{ts, 0, int(le.Uint32(b[12:])), b[16 : 16+caplen]})
+		b = b[16+caplen:]
+	}
+	return recs, nil
+}
+
+// parsePcapNg parses pcapng file. Interface id of the packet is
+// reported as the port.
+func parsePcapNg(b []byte, snapLen int) ([]pcapRecord, error) {
+	le := binary.LittleEndian
+	var recs []pcapRecord
+	ifaces := 0
+	for first := true; len(b) > 0; first = false {
+		if len(b) < 12 {
+			return nil, fmt.Errorf("truncated block")
+		}
+		typ, n := le.Uint32(b), int(le.Uint32(b[4:]))
+		if n < 12 || n&3 != 0 || len(b) < n || le.Uint32(b[n-4:]) != uint32(n) {
+			return nil, fmt.Errorf("bad block length %d", n)
+		}
+		if first != (typ == pcapngSHB) {
+			return nil, fmt.Errorf("unexpected block %#x", typ)
+		}
+
+		switch typ {
+		case pcapngSHB:
+			if le.Uint32(b[8:]) != pcapngBOM {
+				return nil, fmt.Errorf("bad byte order magic")
+			}
+		case pcapngIDB:
+			if le.Uint16(b[8:]) != pcapLinkType || le.Uint32(b[12:]) != uint32(snapLen) ||
+				!bytes.Equal(b[16:21], []byte{9, 0, 1, 0, 9}) {
+				return nil, fmt.Errorf("bad interface block")
+			}
+			ifaces++
+		case pcapngEPB:
+			id := le.Uint32(b[8:])
+			caplen := int(le.Uint32(b[20:]))
+			if int(id) >= ifaces || caplen > snapLen || 28+caplen > n-4 {
+				return nil, fmt.Errorf("bad packet block")
+			}
+			ts := int64(le.Uint32(b[12:]))<<32 | int64(le.Uint32(b[16:]))
+			recs = append(recs, pcapRecord{ts, id, int(le.Uint32(b[24:])), b[28 : 28+caplen]})
+		default:
+			return nil, fmt.Errorf("unexpected block %#x", typ)
+		}
+		b = b[n:]
+	}
+	return recs, nil
+}
+
+func TestPcapWriter(t *testing.T) {
+	dir, err := ioutil.TempDir("", "pcap")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	const snapLen = 1000
+	reqs, want := pcapReqs(997)
+
+	for _, format := range []int{FormatPcap, FormatPcapNg} {
+		for _, direct := range []bool{false, true} {
+			prefix := filepath.Join(dir, fmt.Sprintf("%d-%v", format, direct))
+			name := func(seq int) string { return fmt.Sprintf("%s-%d", prefix, seq) }
+
+			// small buffers and files to exercise flushing of
+			// unaligned tails and rotation
+			options := []PcapOption{
+				PcapOptFormat(format),
+				PcapOptSnapLen(snapLen),
+				PcapOptBufSize(1),
+				PcapOptRotate(100000, 0),
+			}
+			if direct {
+				options = append(options, PcapOptDirect())
+			}
+
+			w := NewPcapWriter(name, options...)
+			for i := 0; i < len(reqs); i += 10 {
+				end := i + 10
+				if end > len(reqs) {
+					end = len(reqs)
+				}
+				if err := w.WriteBurst(reqs[i:end]); err != nil {
+					t.Fatal(format, direct, err)
+				}
+			}
+			if err := w.Close(); err != nil {
+				t.Fatal(format, direct, err)
+			}
+
+			var got []pcapRecord
+			var files int
+			for ; ; files++ {
+				b, err := ioutil.ReadFile(name(files))
+				if os.IsNotExist(err) {
+					break
+				} else if err != nil {
+					t.Fatal(err)
+				}
+
+				var recs []pcapRecord
+				if format == FormatPcapNg {
+					recs, err = parsePcapNg(b, snapLen)
+				} else {
+					recs, err = parsePcap(b, snapLen)
+				}
+				if err != nil {
+					t.Fatal(name(files), err)
+				}
+
+				// interfaces are numbered in order of appearance
+				// in every file
+				ports := make(map[uint32]uint32)
+				for k := range recs {
+					if len(got)+k >= len(want) {
+						break
+					}
+					if _, ok := ports[recs[k].port]; !ok {
+						ports[recs[k].port] = want[len(got)+k].port
+					}
+					recs[k].port = ports[recs[k].port]
+				}
+				got = append(got, recs...)
+			}
+
+			if files < 3 || len(got) != len(want) {
+				t.Fatal(format, direct, files, len(got))
+			}
+			for i, r := range want {
+				data := r.data
+				if len(data) > snapLen {
+					data = data[:snapLen]
+				}
+				if g := got[i]; g.ts != r.ts || g.orig != r.orig || !bytes.Equal(g.data, data) ||
+					(format == FormatPcapNg && g.port != r.port) {
+					t.Fatal(format, direct, i, g.ts, r.ts, g.orig, r.orig, len(g.data), g.port)
+				}
+			}
+		}
+	}
+}
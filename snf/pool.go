@@ -0,0 +1,262 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"fmt"
+	"io/ioutil"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// BurstFunc is a callback which processes a burst of packets
+// received on a ring with specified id. reqs is valid only until the
+// callback returns.
+type BurstFunc func(id int, reqs []RecvReq)
+
+// RingPool runs a number of rings of a Handle, each on its own
+// goroutine locked to an OS thread, optionally pinned to a CPU.
+type RingPool struct {
+	rings   []*Ring
+	readers []*RingReader
+	opts    poolOpts
+	fn      BurstFunc
+
+	wg      sync.WaitGroup
+	ready   sync.WaitGroup
+	stopped uint32
+	errs    []error
+}
+
+// RingPool options container
+type poolOpts struct {
+	cpus    []int
+	timeout time.Duration
+	burst   int
+	init    func(id int, rr *RingReader)
+}
+
+// PoolOption specifies an option for creating a RingPool.
+type PoolOption struct {
+	f func(*poolOpts)
+}
+
+// PoolOptCPUs specifies CPU set to pin ring threads to. Ring with id
+// i is pinned to cpus[i%len(cpus)]. If not specified, threads are
+// not pinned. NumaCPUs() may be used to retrieve CPUs local to the
+// NIC.
+func PoolOptCPUs(cpus []int) PoolOption {
+	return PoolOption{func(opts *poolOpts) {
+		opts.cpus = cpus
+	}}
+}
+
+// PoolOptTimeout specifies receive timeout for ring readers. It also
+// limits the time needed for the pool to stop. Default is 1ms.
+func PoolOptTimeout(d time.Duration) PoolOption {
+	return PoolOption{func(opts *poolOpts) {
+		opts.timeout = d
+	}}
+}
+
+// PoolOptBurst specifies burst size for ring readers. Default is 256.
+func PoolOptBurst(n int) PoolOption {
+	return PoolOption{func(opts *poolOpts) {
+		opts.burst = n
+	}}
+}
+
+// PoolOptReaderInit specifies a function to set up ring readers, e.g.
+// to install filters. It is invoked on the ring goroutine by Start()
+// for every reader once it's created.
+func PoolOptReaderInit(fn func(id int, rr *RingReader)) PoolOption {
+	return PoolOption{func(opts *poolOpts) {
+		opts.init = fn
+	}}
+}
+
+// NewRingPool opens n rings on Handle h with OpenRingID(). n should
+// match the number of rings the Handle was opened with (see
+// HandlerOptNumRings). fn is invoked for every received burst.
+//
+// A RingReader for every ring is created by Start() on the ring's
+// goroutine after it is pinned to its CPU so that memory of the
+// reader is allocated on the local NUMA node.
+//
+// If any ring fails to open, all previously opened rings are closed
+// and the error is returned.
+func NewRingPool(h *Handle, n int, fn BurstFunc, options ...PoolOption) (*RingPool, error) {
+	p := &RingPool{
+		opts: poolOpts{timeout: time.Millisecond, burst: 256},
+		fn:   fn,
+	}
+
+	for _, opt := range options {
+		opt.f(&p.opts)
+	}
+
+	for i := 0; i < n; i++ {
+		r, err := h.OpenRingID(i)
+		if err != nil {
+			p.Close()
+			return nil, err
+		}
+		p.rings = append(p.rings, r)
+	}
+
+	p.readers = make([]*RingReader, n)
+	p.errs = make([]error, n)
+	return p, nil
+}
+
+// Readers returns ring readers of the pool, indexed by ring id. The
+// readers are created by Start(), the reader of a ring is nil if its
+// goroutine failed to be pinned to the CPU.
+func (p *RingPool) Readers() []*RingReader {
+	return p.readers
+}
+
+// Start launches processing of all rings and waits for the ring
+// readers to be created. Please note that Handle's Start() should be
+// called as well for the NIC to deliver packets.
+func (p *RingPool) Start() {
+	for i := range p.rings {
+		p.wg.Add(1)
+		p.ready.Add(1)
+		go p.run(i)
+	}
+	p.ready.Wait()
+}
+
+func (p *RingPool) run(id int) {
+	defer p.wg.Done()
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	if cpus := p.opts.cpus; len(cpus) > 0 {
+		if err := setAffinity(cpus[id%len(cpus)]); err != nil {
+			p.errs[id] = err
+			p.ready.Done()
+			return
+		}
+	}
+
+	// first touch of the reader's memory from the pinned thread
+	rr := NewReader(p.rings[id], p.opts.timeout, p.opts.burst)
+	if p.opts.init != nil {
+		p.opts.init(id, rr)
+	}
+	p.readers[id] = rr
+	p.ready.Done()
+
+	for atomic.LoadUint32(&p.stopped) == 0 {
+		if reqs := rr.NextBatch(); reqs != nil {
+			p.fn(id, reqs)
+		} else if err := rr.Err(); err != syscall.EAGAIN {
+			p.errs[id] = err
+			return
+		}
+	}
+}
+
+// Stop signals all ring goroutines to exit. Use Wait() to wait for
+// them to do so.
+func (p *RingPool) Stop() {
+	atomic.StoreUint32(&p.stopped, 1)
+}
+
+// Wait waits for all ring goroutines to exit and returns the first
+// error encountered by any of them.
+func (p *RingPool) Wait() error {
+	p.wg.Wait()
+	for _, err := range p.errs {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Close frees all ring readers and closes rings. The pool should be
+// stopped prior to closing.
+func (p *RingPool) Close() error {
+	var err error
+	for i, r := range p.rings {
+		if i < len(p.readers) && p.readers[i] != nil {
+			p.readers[i].Free()
+		}
+		if e := r.Close(); err == nil {
+			err = e
+		}
+	}
+	return err
+}
+
+// setAffinity pins calling OS thread to the cpu.
+func setAffinity(cpu int) error {
+	var mask [16]uint64
+	if cpu < 0 || cpu >= len(mask)*64 {
+		return syscall.EINVAL
+	}
+
+	mask[cpu/64] |= 1 << uint(cpu%64)
+	_, _, e := syscall.RawSyscall(syscall.SYS_SCHED_SETAFFINITY, 0,
+		unsafe.Sizeof(mask), uintptr(unsafe.Pointer(&mask)))
+	if e != 0 {
+		return e
+	}
+	return nil
+}
+
+// NumaCPUs returns a list of CPUs local to the NUMA node of network
+// interface with specified name, as in ifconfig (see IfAddrs'
+// Name()). If the NUMA node is unknown, all online CPUs are returned.
+func NumaCPUs(ifname string) ([]int, error) {
+	b, err := ioutil.ReadFile("/sys/class/net/" + ifname + "/device/numa_node")
+	if err != nil {
+		return nil, err
+	}
+
+	path := "/sys/devices/system/cpu/online"
+	if node, err := strconv.Atoi(strings.TrimSpace(string(b))); err != nil {
+		return nil, err
+	} else if node >= 0 {
+		path = fmt.Sprintf("/sys/devices/system/node/node%d/cpulist", node)
+	}
+
+	if b, err = ioutil.ReadFile(path); err != nil {
+		return nil, err
+	}
+	return parseCPUList(strings.TrimSpace(string(b)))
+}
+
+// parseCPUList parses CPU list in sysfs format, e.g. "0-3,8,10-11".
+func parseCPUList(s string) (cpus []int, err error) {
+	for _, r := range strings.Split(s, ",") {
+		var lo, hi int
+		bounds := strings.SplitN(r, "-", 2)
+		if lo, err = strconv.Atoi(bounds[0]); err != nil {
+			return nil, err
+		}
+		hi = lo
+		if len(bounds) > 1 {
+			if hi, err = strconv.Atoi(bounds[1]); err != nil {
+				return nil, err
+			}
+		}
+		for cpu := lo; cpu <= hi; cpu++ {
+			cpus = append(cpus, cpu)
+		}
+	}
+	return cpus, nil
+}
@@ -0,0 +1,151 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"bytes"
+	"io"
+	"strconv"
+	"strings"
+)
+
+type promFamily struct {
+	help, typ string
+	samples   bytes.Buffer
+}
+
+// PromWriter collects metrics of rings, readers and injection handles
+// and writes them in Prometheus text exposition format. Samples of
+// every metric are grouped together in the output regardless of the
+// order they were added in.
+//
+// Labels are specified as pairs of name and value, e.g. "port", "0",
+// "ring", "1".
+type PromWriter struct {
+	families map[string]*promFamily
+	order    []string
+}
+
+// NewPromWriter creates empty PromWriter.
+func NewPromWriter() *PromWriter {
+	return &PromWriter{families: make(map[string]*promFamily)}
+}
+
+var promEscaper = strings.NewReplacer(`\`, `\\`, `"`, `\"`, "\n", `\n`)
+
+func promLabels(b *bytes.Buffer, labels []string, extra ...string) {
+	labels = append(labels[:len(labels):len(labels)], extra...)
+	if len(labels) < 2 {
+		return
+	}
+
+	b.WriteByte('{')
+	for i := 0; i+1 < len(labels); i += 2 {
+		if i > 0 {
+			b.WriteByte(',')
+		}
+		b.WriteString(labels[i])
+		b.WriteString(`="`)
+		promEscaper.WriteString(b, labels[i+1])
+		b.WriteByte('"')
+	}
+	b.WriteByte('}')
+}
+
+func (p *PromWriter) family(name, typ, help string) *promFamily {
+	f, ok := p.families[name]
+	if !ok {
+		f = &promFamily{help: help, typ: typ}
+		p.families[name] = f
+		p.order = append(p.order, name)
+	}
+	return f
+}
+
+func (p *PromWriter) sample(name, suffix, typ, help string, v float64, labels []string, extra ...string) {
+	b := &p.family(name, typ, help).samples
+	b.WriteString(name)
+	b.WriteString(suffix)
+	promLabels(b, labels, extra...)
+	b.WriteByte(' ')
+	b.WriteString(strconv.FormatFloat(v, 'g', -1, 64))
+	b.WriteByte('\n')
+}
+
+func (p *PromWriter) counter(name, help string, v uint64, labels []string) {
+	p.sample(name, "", "counter", help, float64(v), labels)
+}
+
+// RingStats adds statistics of a receive ring.
+func (p *PromWriter) RingStats(s *RingStats, labels ...string) {
+	p.counter("snf_nic_pkt_recv_total", "Packets received by the NIC.", s.NicPktRecv, labels)
+	p.counter("snf_nic_pkt_overflow_total", "Packets dropped by the NIC.", s.NicPktOverflow, labels)
+	p.counter("snf_nic_pkt_bad_total", "Bad CRC/PHY packets seen by the NIC.", s.NicPktBad, labels)
+	p.counter("snf_ring_pkt_recv_total", "Packets received into the ring.", s.RingPktRecv, labels)
+	p.counter("snf_ring_pkt_overflow_total", "Packets dropped due to insufficient space in the ring.", s.RingPktOverflow, labels)
+	p.counter("snf_nic_bytes_recv_total", "Raw bytes received by the NIC.", s.NicBytesRecv, labels)
+	p.counter("snf_pkt_overflow_total", "Packets dropped due to insufficient space in SNF buffering.", s.SnfPktOverflow, labels)
+	p.counter("snf_nic_pkt_dropped_total", "Packets dropped by Packets Drop Filter.", s.NicPktDropped, labels)
+}
+
+// InjectStats adds statistics of an injection handle.
+func (p *PromWriter) InjectStats(s *InjectStats, labels ...string) {
+	p.counter("snf_inj_pkt_send_total", "Packets sent by the injection handle.", s.InjPktSend(), labels)
+	p.counter("snf_nic_pkt_send_total", "Packets sent by the NIC.", s.NicPktSend(), labels)
+	p.counter("snf_nic_bytes_send_total", "Raw bytes sent by the NIC.", s.NicBytesSend(), labels)
+}
+
+// ReaderCounters adds telemetry counters of a RingReader.
+func (p *PromWriter) ReaderCounters(c *ReaderCounters, labels ...string) {
+	p.counter("snf_reader_pkts_total", "Packets received by the reader.", c.Pkts, labels)
+	p.counter("snf_reader_bytes_total", "Bytes borrowed by the reader.", c.Bytes, labels)
+	p.counter("snf_reader_bursts_total", "Successful receive calls of the reader.", c.Bursts, labels)
+}
+
+// Histogram adds histogram of nanosecond values as a Prometheus
+// histogram in seconds. Buckets are powers of 2 from about 1
+// microsecond up to about 1 minute. Since the values are integers and
+// CountBelow() is exact for powers of 2, the bucket of values less
+// than 2^k nanoseconds is exported with le of 2^k-1 nanoseconds.
+func (p *PromWriter) Histogram(name, help string, h *Histogram, labels ...string) {
+	const typ = "histogram"
+
+	count := h.Count()
+	for shift := uint(10); shift <= 36; shift++ {
+		below := uint64(1) << shift
+		p.sample(name, "_bucket", typ, help, float64(h.CountBelow(below)), labels,
+			"le", strconv.FormatFloat(float64(below-1)/1e9, 'g', -1, 64))
+	}
+	p.sample(name, "_bucket", typ, help, float64(count), labels, "le", "+Inf")
+	p.sample(name, "_sum", typ, help, float64(h.Sum())/1e9, labels)
+	p.sample(name, "_count", typ, help, float64(count), labels)
+}
+
+// LatencyStats adds latency and inter-arrival distributions.
+func (p *PromWriter) LatencyStats(s *LatencyStats, labels ...string) {
+	p.Histogram("snf_reader_latency_seconds", "Capture to processing latency of packets.", &s.Latency, labels...)
+	p.Histogram("snf_reader_interarrival_seconds", "Inter-arrival time of packets.", &s.InterArrival, labels...)
+}
+
+// WriteTo writes collected metrics to w. It implements io.WriterTo
+// interface.
+func (p *PromWriter) WriteTo(w io.Writer) (int64, error) {
+	var b bytes.Buffer
+	for _, name := range p.order {
+		f := p.families[name]
+		b.WriteString("# HELP " + name + " " + f.help + "\n")
+		b.WriteString("# TYPE " + name + " " + f.typ + "\n")
+		b.Write(f.samples.Bytes())
+	}
+	return b.WriteTo(w)
+}
+
+// Reset clears collected metrics.
+func (p *PromWriter) Reset() {
+	p.families = make(map[string]*promFamily)
+	p.order = p.order[:0]
+}
@@ -47,3 +47,18 @@ func (ref *ReflectHandle) Reflect(pkt []byte) error {
 	return retErr(C.snf_netdev_reflect(C.snf_netdev_reflect_t(ref),
 		unsafe.Pointer(&pkt[0]), C.uint(len(pkt))))
 }
+
+// ReflectReqs reflects packets of received descriptors, e.g. obtained
+// with RingReader's NextBatch(), to the network device straight from
+// the receive ring memory with a single cgo call.
+//
+// The output is the number of reflected packets and an error if any.
+func (ref *ReflectHandle) ReflectReqs(reqs []RecvReq) (int, error) {
+	if len(reqs) == 0 {
+		return 0, nil
+	}
+
+	out := C.reflect_recv_reqs(C.snf_netdev_reflect_t(ref),
+		(*C.struct_snf_recv_req)(&reqs[0]), C.int(len(reqs)))
+	return intErr(&out)
+}
@@ -0,0 +1,188 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"errors"
+	"os"
+	"syscall"
+)
+
+// ErrPcapFormat is returned if the pcap file is malformed.
+var ErrPcapFormat = errors.New("unsupported or malformed pcap file")
+
+// Replayer replays packets from a memory mapped pcap file via
+// Sender, with hardware pacing according to packet timestamps.
+//
+// Packets are sent directly from the mapped file with batched cgo
+// calls. Only classic pcap format is supported, with either
+// microsecond or nanosecond timestamps.
+type Replayer struct {
+	data []byte
+	pkts [][]byte
+
+	// packet timestamps in nanoseconds
+	ts []int64
+
+	// precomputed inter-packet delays
+	delays []int64
+}
+
+// OpenReplayer maps pcap file into memory and indexes its packets.
+// Packets are paced at original speed, see SetSpeed().
+func OpenReplayer(path string) (*Replayer, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	fi, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+
+	if fi.Size() < 24 {
+		return nil, ErrPcapFormat
+	}
+
+	data, err := syscall.Mmap(int(f.Fd()), 0, int(fi.Size()),
+		syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, err
+	}
+
+	r := &Replayer{data: data}
+	if err = r.index(); err != nil {
+		r.Close()
+		return nil, err
+	}
+
+	r.SetSpeed(1)
+	return r, nil
+}
+
+// index parses pcap records.
+func (r *Replayer) index() error {
+	var bo binary.ByteOrder
+	var nsec int64
+
+	magic := binary.LittleEndian.Uint32(r.data)
+	switch magic {
+	case 0xa1b2c3d4, 0xa1b23c4d:
+		bo = binary.LittleEndian
+	case 0xd4c3b2a1, 0x4d3cb2a1:
+		bo = binary.BigEndian
+		magic = bo.Uint32(r.data)
+	default:
+		return ErrPcapFormat
+	}
+
+	if nsec = 1000; magic == 0xa1b23c4d {
+		nsec = 1
+	}
+
+	for off := 24; off < len(r.data); {
+		if off+16 > len(r.data) {
+			return ErrPcapFormat
+		}
+
+		hdr := r.data[off : off+16]
+		caplen := int(bo.Uint32(hdr[8:]))
+		off += 16
+		if caplen == 0 || off+caplen > len(r.data) {
+			return ErrPcapFormat
+		}
+
+		ts := int64(bo.Uint32(hdr[0:]))*1e9 + int64(bo.Uint32(hdr[4:]))*nsec
+		r.ts = append(r.ts, ts)
+		r.pkts = append(r.pkts, r.data[off:off+caplen])
+		off += caplen
+	}
+
+	r.delays = make([]int64, len(r.pkts))
+	return nil
+}
+
+// Len returns the number of packets in the file.
+func (r *Replayer) Len() int {
+	return len(r.pkts)
+}
+
+// SetSpeed precomputes inter-packet delays for the speed multiplier,
+// e.g. 2 means replaying twice as fast as the packets were captured.
+// If speed is not positive, packets are sent with no pacing.
+func (r *Replayer) SetSpeed(speed float64) {
+	for i := range r.delays {
+		r.delays[i] = 0
+		if i > 0 && speed > 0 {
+			if d := r.ts[i] - r.ts[i-1]; d > 0 {
+				r.delays[i] = int64(float64(d) / speed)
+			}
+		}
+	}
+}
+
+// Replay sends packets of the file loops times, or indefinitely if
+// loops is not positive, in batches of batch packets. If pacing is
+// enabled, packets are sent with Sender's SchedBatch(), otherwise
+// with SendBatch(). The first packet of every loop is sent with no
+// delay. EAGAIN errors are retried. If the file holds no packets,
+// Replay returns immediately.
+//
+// The number of sent packets and an error, if any, is returned.
+func (r *Replayer) Replay(s *Sender, loops, batch int) (sent int, err error) {
+	if batch <= 0 {
+		batch = 1
+	}
+
+	if len(r.pkts) == 0 {
+		return 0, nil
+	}
+
+	paced := false
+	for _, d := range r.delays {
+		if d != 0 {
+			paced = true
+			break
+		}
+	}
+
+	for loop := 0; loops <= 0 || loop < loops; loop++ {
+		for i := 0; i < len(r.pkts); {
+			j := i + batch
+			if j > len(r.pkts) {
+				j = len(r.pkts)
+			}
+
+			var n int
+			if paced {
+				n, err = s.SchedBatch(r.delays[i:j], r.pkts[i:j])
+			} else {
+				n, err = s.SendBatch(r.pkts[i:j])
+			}
+
+			sent += n
+			i += n
+			if err == syscall.EAGAIN {
+				err = nil
+			} else if err != nil {
+				return sent, err
+			}
+		}
+	}
+
+	return sent, nil
+}
+
+// Close unmaps the file.
+func (r *Replayer) Close() error {
+	data := r.data
+	r.data, r.pkts = nil, nil
+	return syscall.Munmap(data)
+}
@@ -124,7 +124,11 @@ func (r *Ring) Close() error {
 // incorrect.
 func (r *Ring) Stats() (*RingStats, error) {
 	stats := &RingStats{}
-	return stats, retErr(C.snf_ring_getstats(ring(r),
+	return stats, r.getStats(stats)
+}
+
+func (r *Ring) getStats(stats *RingStats) error {
+	return retErr(C.snf_ring_getstats(ring(r),
 		(*C.struct_snf_ring_stats)(unsafe.Pointer(stats))))
 }
 
@@ -0,0 +1,146 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "ring_desc.h"
+*/
+import "C"
+
+import (
+	"syscall"
+	"unsafe"
+)
+
+// RingDesc is a compact 16-byte packet descriptor. Packet data is
+// referred to by offset in the data region of a physical ring rather
+// than by absolute address, so arrays of RingDesc may be shipped to
+// other processes sharing the ring (see PShared flag) which resolve
+// packets against their own mapping of the region with RingRegion.
+//
+// RingDesc doesn't carry the hash calculated by the NIC.
+type RingDesc C.struct_ring_desc
+
+// Offset returns offset of packet data in the data region.
+func (d *RingDesc) Offset() uint32 {
+	return uint32(d.off)
+}
+
+// Length returns packet length.
+func (d *RingDesc) Length() int {
+	return int(d.length)
+}
+
+// PortNum returns packet's origin port number.
+func (d *RingDesc) PortNum() int {
+	return int(d.portnum)
+}
+
+// Timestamp returns 64-bit timestamp in nanoseconds.
+func (d *RingDesc) Timestamp() int64 {
+	return int64(d.timestamp)
+}
+
+// RingRegion is a data region of a physical receive ring as mapped
+// in the current process.
+//
+// RingDesc refers to packets by 32-bit offset and 16-bit length, so
+// only the first 4GiB of the region may be addressed and packets
+// longer than 64KiB can't be described.
+type RingRegion []byte
+
+// Region returns data region of the receive ring. See Data().
+func (pi *RingPortInfo) Region() RingRegion {
+	return RingRegion(pi.Data())
+}
+
+// Encode converts packet descriptors into compact descriptors
+// relative to the region. Packets outside of the region, e.g. received
+// on other physical rings of an aggregated ring, or not addressable
+// by RingDesc are skipped.
+//
+// Returns the number of descriptors written into descs which should
+// be at least as long as reqs.
+func (r RingRegion) Encode(reqs []RecvReq, descs []RingDesc) int {
+	if len(reqs) == 0 || len(r) == 0 {
+		return 0
+	}
+
+	if len(descs) < len(reqs) {
+		panic("descs is too short")
+	}
+
+	return int(C.ring_desc_encode((*C.struct_snf_recv_req)(&reqs[0]),
+		C.int(len(reqs)), C.uintptr_t(uintptr(unsafe.Pointer(&r[0]))),
+		C.uint64_t(len(r)), (*C.struct_ring_desc)(&descs[0])))
+}
+
+// Data returns data of the packet described by d. The slice points
+// directly into the region and is valid as long as the packet is not
+// returned to the ring by its owner.
+func (r RingRegion) Data(d *RingDesc) []byte {
+	off := int(d.off)
+	return r[off : off+int(d.length) : off+int(d.length)]
+}
+
+// DescReader receives bursts of packets with RingReader and converts
+// them into compact descriptors relative to the ring's data region.
+//
+// RingReader should be opened on a physical ring. The packets of the
+// burst are held until the next call to NextDescs(), so consumers of
+// the descriptors, possibly in other processes, should finish with
+// the packets by then.
+type DescReader struct {
+	*RingReader
+	region  RingRegion
+	descs   []RingDesc
+	skipped uint64
+}
+
+// NewDescReader creates DescReader on top of RingReader. pi is the
+// ring's information, see Ring's PortInfo().
+//
+// EINVAL is returned if the ring's data region is larger than 4GiB
+// and thus can't be entirely addressed by RingDesc.
+func NewDescReader(rr *RingReader, pi *RingPortInfo) (*DescReader, error) {
+	region := pi.Region()
+	if uint64(len(region)) > 1<<32 {
+		return nil, syscall.EINVAL
+	}
+
+	return &DescReader{
+		RingReader: rr,
+		region:     region,
+		descs:      make([]RingDesc, rr.reader.nreq_in),
+	}, nil
+}
+
+// Region returns data region of the ring.
+func (d *DescReader) Region() RingRegion {
+	return d.region
+}
+
+// NextDescs receives next burst of packets and returns their compact
+// descriptors. The returned slice is valid until the next call to
+// NextDescs(). If nil is returned, you should examine Err().
+func (d *DescReader) NextDescs() []RingDesc {
+	reqs := d.NextBatch()
+	if reqs == nil {
+		return nil
+	}
+
+	n := d.region.Encode(reqs, d.descs)
+	d.skipped += uint64(len(reqs) - n)
+	return d.descs[:n]
+}
+
+// Skipped returns the number of received packets which were not
+// described by NextDescs() since they were outside of the region or
+// longer than 64KiB.
+func (d *DescReader) Skipped() uint64 {
+	return d.skipped
+}
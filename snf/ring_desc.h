@@ -0,0 +1,55 @@
+#ifndef _RING_DESC_H_
+#define _RING_DESC_H_
+
+#include <stdint.h>
+
+#include "wrapper.h"
+
+/*
+ * Compact packet descriptor, 16 bytes. Packet data is referred to by
+ * its offset in the data region of a physical ring so the descriptor
+ * is meaningful in every process sharing the ring.
+ */
+struct ring_desc {
+	uint32_t off; // offset of packet data in the data region
+	uint16_t length; // packet length
+	uint8_t portnum; // origin port number
+	uint8_t reserved;
+	uint64_t timestamp; // timestamp in nanoseconds
+};
+
+/*
+ * Convert n packet descriptors from reqs into compact descriptors
+ * relative to data region starting at base of size bytes. Packets
+ * which don't entirely fit into the region, start beyond 4GiB into
+ * the region or are longer than 64KiB are skipped.
+ *
+ * Return the number of descriptors written into descs.
+ */
+static int
+ring_desc_encode(const struct snf_recv_req *reqs, int n, uintptr_t base,
+		uint64_t size, struct ring_desc *descs)
+{
+	int i, k = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct snf_recv_req *r = &reqs[i];
+		uintptr_t addr = (uintptr_t)r->pkt_addr;
+
+		if (addr < base || addr - base + r->length > size ||
+				addr - base > UINT32_MAX || r->length > UINT16_MAX) {
+			continue;
+		}
+
+		descs[k].off = (uint32_t)(addr - base);
+		descs[k].length = (uint16_t)r->length;
+		descs[k].portnum = (uint8_t)r->portnum;
+		descs[k].reserved = 0;
+		descs[k].timestamp = r->timestamp;
+		k++;
+	}
+
+	return k;
+}
+
+#endif /* _RING_DESC_H_ */
@@ -0,0 +1,233 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"os"
+	"runtime"
+	"sync/atomic"
+	"syscall"
+	"time"
+)
+
+// RingPoller options container
+type pollerOpts struct {
+	spins    int
+	yields   int
+	minSleep time.Duration
+	maxSleep time.Duration
+	queue    int
+}
+
+// PollerOption specifies an option for creating a RingPoller.
+type PollerOption struct {
+	f func(*pollerOpts)
+}
+
+// PollerOptBackoff specifies backoff of RingPoller when all rings are
+// idle. After spins empty rounds of polling RingPoller starts yielding
+// the processor with runtime.Gosched(), after further yields empty
+// rounds it starts sleeping for minSleep, doubling the sleep on every
+// empty round up to maxSleep. Default is 64 spins, 64 yields and
+// sleeping from 1us to 1ms.
+func PollerOptBackoff(spins, yields int, minSleep, maxSleep time.Duration) PollerOption {
+	return PollerOption{func(opts *pollerOpts) {
+		opts.spins = spins
+		opts.yields = yields
+		opts.minSleep = minSleep
+		opts.maxSleep = maxSleep
+	}}
+}
+
+// PollerOptQueue specifies capacity of the bursts channel, see
+// Bursts(). Default is 64.
+func PollerOptQueue(n int) PollerOption {
+	return PollerOption{func(opts *pollerOpts) {
+		opts.queue = n
+	}}
+}
+
+// PollBurst is a burst of packets received by RingPoller in channel
+// mode. Reqs are valid until Done() is called, after that the ring is
+// polled again.
+type PollBurst struct {
+	// ID is the index of the reader as returned by Add().
+	ID   int
+	Reqs []RecvReq
+
+	busy *uint32
+}
+
+// Done signals that processing of the burst is finished. It may be
+// called from any goroutine.
+func (b *PollBurst) Done() {
+	atomic.StoreUint32(b.busy, 0)
+}
+
+// RingPoller services many RingReaders from a single goroutine. The
+// rings are polled with 0 timeout so no OS thread is blocked in cgo
+// while a ring is idle. If none of the rings has packets, RingPoller
+// backs off from spinning to yielding to sleeping, see
+// PollerOptBackoff().
+//
+// Bursts are delivered either to a callback on the polling goroutine
+// or to a channel. In the latter case a ring is not polled until the
+// burst received from it is Done().
+//
+// RingPoller handles signals installed with NotifyWith() itself, so
+// the readers don't need their own NotifyWith().
+type RingPoller struct {
+	readers []*RingReader
+	busy    []uint32
+	fn      BurstFunc
+	ch      chan PollBurst
+	opts    pollerOpts
+
+	sigCh   <-chan os.Signal
+	stopped uint32
+
+	// empty polling rounds in a row
+	idle  int
+	sleep time.Duration
+}
+
+// NewRingPoller creates RingPoller. fn is invoked on the polling
+// goroutine for every received burst. If fn is nil, bursts are sent
+// to the channel returned by Bursts().
+func NewRingPoller(fn BurstFunc, options ...PollerOption) *RingPoller {
+	p := &RingPoller{
+		fn: fn,
+		opts: pollerOpts{
+			spins:    64,
+			yields:   64,
+			minSleep: time.Microsecond,
+			maxSleep: time.Millisecond,
+			queue:    64,
+		},
+	}
+
+	for _, opt := range options {
+		opt.f(&p.opts)
+	}
+
+	if fn == nil {
+		p.ch = make(chan PollBurst, p.opts.queue)
+	}
+	return p
+}
+
+// Add adds a reader to the poller and returns its id. The receive
+// timeout of the reader is reset to 0. Readers should be added
+// before Run().
+func (p *RingPoller) Add(rr *RingReader) int {
+	rr.reader.timeout_ms = 0
+	p.readers = append(p.readers, rr)
+	p.busy = append(p.busy, 0)
+	return len(p.readers) - 1
+}
+
+// Readers returns readers of the poller indexed by their ids.
+func (p *RingPoller) Readers() []*RingReader {
+	return p.readers
+}
+
+// Bursts returns the channel of bursts if the poller was created with
+// nil callback. The channel is closed once Run() returns.
+func (p *RingPoller) Bursts() <-chan PollBurst {
+	return p.ch
+}
+
+// NotifyWith installs signal notification channel which is presumably
+// registered via signal.Notify. The channel is checked once per
+// polling round and Run() returns ErrSignal upon signal.
+func (p *RingPoller) NotifyWith(ch <-chan os.Signal) {
+	p.sigCh = ch
+}
+
+// Stop signals Run() to return.
+func (p *RingPoller) Stop() {
+	atomic.StoreUint32(&p.stopped, 1)
+}
+
+// Poll polls every ring once and delivers received bursts. It returns
+// the number of received packets and the first error other than
+// EAGAIN.
+func (p *RingPoller) Poll() (n int, err error) {
+	for i, rr := range p.readers {
+		if p.ch != nil && atomic.LoadUint32(&p.busy[i]) != 0 {
+			continue
+		}
+
+		reqs := rr.NextBatch()
+		if reqs == nil {
+			if err = rr.Err(); err != syscall.EAGAIN {
+				return n, err
+			}
+			err = nil
+			continue
+		}
+
+		n += len(reqs)
+		if p.ch == nil {
+			p.fn(i, reqs)
+		} else {
+			atomic.StoreUint32(&p.busy[i], 1)
+			p.ch <- PollBurst{ID: i, Reqs: reqs, busy: &p.busy[i]}
+		}
+	}
+
+	return n, nil
+}
+
+// backoff waits after an empty polling round.
+func (p *RingPoller) backoff() {
+	switch p.idle++; {
+	case p.idle <= p.opts.spins:
+	case p.idle <= p.opts.spins+p.opts.yields:
+		runtime.Gosched()
+	default:
+		if p.sleep < p.opts.minSleep {
+			p.sleep = p.opts.minSleep
+		}
+		time.Sleep(p.sleep)
+		if p.sleep *= 2; p.sleep > p.opts.maxSleep {
+			p.sleep = p.opts.maxSleep
+		}
+	}
+}
+
+// Run polls the rings until Stop() is called, a signal is caught or
+// an error other than EAGAIN is encountered on any of the rings. It
+// should be called from a single goroutine.
+func (p *RingPoller) Run() error {
+	if p.ch != nil {
+		defer close(p.ch)
+	}
+
+	for atomic.LoadUint32(&p.stopped) == 0 {
+		if ch := p.sigCh; ch != nil {
+			select {
+			case sig := <-ch:
+				return &ErrSignal{sig}
+			default:
+			}
+		}
+
+		n, err := p.Poll()
+		if err != nil {
+			return err
+		}
+
+		if n > 0 {
+			p.idle, p.sleep = 0, 0
+		} else {
+			p.backoff()
+		}
+	}
+
+	return nil
+}
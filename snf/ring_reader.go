@@ -9,12 +9,14 @@ package snf
 /*
 #include "wrapper.h"
 #include "ring_reader.h"
+#include "warmup.h"
 */
 import "C"
 
 import (
 	"fmt"
 	"os"
+	"reflect"
 	"runtime"
 	"sync/atomic"
 	"syscall"
@@ -36,8 +38,40 @@ type RingReader struct {
 
 	err error
 
+	// all snf_recv_req descriptors allocated in reader
+	reqs []RecvReq
+
+	// packets received by the last recharge
+	burst []RecvReq
+
 	// index of current snf_recv_req
-	n C.int
+	n int
+
+	// partial return thresholds, see SetReturnThreshold
+	retBytes uint32
+	retPkts  int
+
+	// consumed but not yet returned packets of current burst
+	pendBytes uint32
+	pendPkts  int
+
+	// C memory owned by installed filter
+	filterMem unsafe.Pointer
+
+	// copy arena for ReadPacketData
+	arena *Arena
+
+	// headers decoder, see Decode
+	dec *Decoder
+
+	// latency stats, see SetLatencyStats
+	lat *LatencyStats
+
+	// timestamp of the last packet recorded into lat
+	latLast int64
+
+	// flow table, see SetFlowTable
+	flows *FlowTable
 }
 
 // ErrSignal wraps os.Signal as an error.
@@ -48,11 +82,15 @@ func (e *ErrSignal) Error() string {
 	return fmt.Sprintf("Caught signal: %v", e.Signal)
 }
 
-func (rr *RingReader) recvReq(n C.int) *RecvReq {
-	p := unsafe.Pointer(rr.reader)
+// reqVector maps req_vector of the reader as a slice of RecvReq.
+func reqVector(reader *C.struct_ring_reader) (reqs []RecvReq) {
+	p := unsafe.Pointer(reader)
 	p = unsafe.Pointer(uintptr(p) + uintptr(C.RING_READER_REQ_VECTOR_OFF))
-	p = unsafe.Pointer(uintptr(p) + uintptr(n)*C.sizeof_struct_snf_recv_req)
-	return (*RecvReq)(p)
+	sh := (*reflect.SliceHeader)(unsafe.Pointer(&reqs))
+	sh.Data = uintptr(p)
+	sh.Len = int(reader.nreq_in)
+	sh.Cap = int(reader.nreq_in)
+	return
 }
 
 // Ring returns underlying receive ring.
@@ -73,16 +111,52 @@ func (rr *RingReader) Stats() (*RingStats, error) {
 // with aggregated rings (flag AggregatePortMask must be off).  If you
 // want to use AggregatePortMask feature, please use burst==1. In that
 // case, RingReader will utilize snf_ring_recv() which works in both
-// cases.
+// cases.  Alternatively, AggReader may be used in order to
+// receive bursts from the physical rings of an aggregated ring.
+//
+// The descriptors are allocated page aligned and faulted in by the
+// calling thread, so the reader should be created on the thread, or
+// at least the NUMA node, which is going to use it.
 func NewReader(r *Ring, timeout time.Duration, burst int) *RingReader {
-	reader := (*C.struct_ring_reader)(C.malloc(C.ring_reader_size(C.int(burst))))
+	reader := (*C.struct_ring_reader)(C.warmup_alloc(C.ring_reader_size(C.int(burst))))
 	reader.ringh = (*C.struct_snf_ring)(r)
 	reader.timeout_ms = dur2ms(timeout)
 	reader.nreq_out = 0
 	reader.nreq_in = C.int(burst)
+	reader.nreq_ret = 0
+	reader.data_qlen = 0
+	reader.qinfo = C.struct_snf_ring_qinfo{}
+	reader.filter = nil
+	reader.filter_ctx = nil
+	reader.filtered = 0
+	reader.burst_fn = nil
+	reader.burst_ctx = nil
+	reader.sampling = 0
+	reader.sample_every = 0
+	reader.sample_cnt = 0
+	reader.sample_hash = 0
+	reader.tb_rate = 0
+	reader.tb_depth = 0
+	reader.tb_fill = 0
+	reader.tb_tokens = 0
+	reader.tb_last = 0
+	reader.sampled = 0
+	reader.limited = 0
+	reader.pkts = 0
+	reader.bytes = 0
+	reader.bursts = 0
+	reader.adaptive = 0
+	reader.nreq_cur = reader.nreq_in
+	reader.nreq_min = reader.nreq_in
+	reader.polling = 0
+	reader.idle = 0
+	reader.idle_max = 0
 
 	rr := &RingReader{reader: reader}
+	rr.reqs = reqVector(reader)
+	rr.burst = rr.reqs[:0]
 	runtime.SetFinalizer(rr, func(rr *RingReader) {
+		C.free(rr.filterMem)
 		C.free(unsafe.Pointer(rr.reader))
 	})
 	return rr
@@ -92,25 +166,332 @@ func NewReader(r *Ring, timeout time.Duration, burst int) *RingReader {
 // success, otherwise you should halt all actions on the receiver
 // until Err() error is examined and needed actions are performed.
 func (rr *RingReader) Next() bool {
-	if rr.n++; rr.n >= rr.reader.nreq_out {
-		if atomic.LoadUint32(&rr.stopped) > 0 {
-			rr.err = &ErrSignal{rr.sig}
+	if rr.n++; rr.n >= len(rr.burst) {
+		if !rr.recharge() {
 			return false
 		}
+		rr.n = 0
+	} else if rr.retBytes > 0 || rr.retPkts > 0 {
+		return rr.returnConsumed()
+	}
+
+	return true
+}
+
+// SetReturnThreshold enables partial return of the current burst.
+// Once consumed packets of the burst accumulate at least bytes of
+// borrowed data or at least pkts packets, Next() returns them to the
+// ring instead of waiting for the whole burst to be consumed. That
+// way the NIC regains data ring space while the rest of the burst is
+// being processed. Zero value disables the corresponding threshold.
+//
+// Partial return is only applicable to packets iterated with Next()
+// and only if burst specified in NewReader() is greater than 1.
+func (rr *RingReader) SetReturnThreshold(bytes, pkts int) {
+	rr.retBytes = uint32(bytes)
+	rr.retPkts = pkts
+}
+
+// returnConsumed accounts previous packet in the burst as consumed
+// and returns consumed packets if thresholds are hit. If the return
+// fails, the current packet is left to be delivered by the next
+// call to Next().
+func (rr *RingReader) returnConsumed() bool {
+	pendBytes := rr.pendBytes + uint32(rr.burst[rr.n-1].length_data)
+	pendPkts := rr.pendPkts + 1
+
+	if (rr.retBytes == 0 || pendBytes < rr.retBytes) &&
+		(rr.retPkts == 0 || pendPkts < rr.retPkts) {
+		rr.pendBytes, rr.pendPkts = pendBytes, pendPkts
+		return true
+	}
 
-		rr.err = retErr(C.ring_reader_recharge(rr.reader))
+	if rr.reader.nreq_in > 1 {
+		rr.err = retErr(C.ring_reader_return_upto(rr.reader, C.int(rr.n),
+			C.uint32_t(pendBytes)))
 		if rr.err != nil {
-			rr.reader.nreq_out = 0
+			rr.n--
 			return false
 		}
+	}
+
+	rr.pendBytes, rr.pendPkts = 0, 0
+	return true
+}
+
+// CFilterFunc is the C implementation of packet filter function.
+type CFilterFunc C.ring_reader_filter_fn
+
+// SetFilter installs packet filter which is invoked in C for every
+// received packet before it is exposed with Next() or NextBatch().
+//
+// fn should comply with the following C function prototype:
+//
+//	int (*ring_reader_filter_fn)(struct snf_recv_req *req, void *ctx);
+//
+// ctx is an opaque context.
+//
+// fn should return non-0 if the packet is to be passed to the user
+// and 0 if the packet is to be dropped. Bursts which contain no
+// matching packets are returned to the ring and received again
+// without crossing into Go. In case of continuous stream of
+// non-matching packets Next() eventually returns false with EAGAIN
+// error so the caller may regain control.
+//
+// Please note that partial return (see SetReturnThreshold) is only
+// accounted for matching packets, so the data of dropped packets is
+// returned with the rest of the burst.
+//
+// If fn is nil, filtering is disabled.
+func (rr *RingReader) SetFilter(fn *CFilterFunc, ctx unsafe.Pointer) {
+	rr.reader.filter = (*C.ring_reader_filter_fn)(unsafe.Pointer(fn))
+	rr.reader.filter_ctx = ctx
+	rr.setFilterMem(nil)
+}
+
+// setFilterMem releases memory of previously installed filter and
+// retains p instead.
+func (rr *RingReader) setFilterMem(p unsafe.Pointer) {
+	C.free(rr.filterMem)
+	rr.filterMem = p
+}
+
+// Filtered returns number of packets dropped by the filter installed
+// with SetFilter().
+func (rr *RingReader) Filtered() uint64 {
+	return uint64(rr.reader.filtered)
+}
+
+func (rr *RingReader) updateSampling() {
+	r := rr.reader
+	r.sampling = 0
+	if r.sample_every > 1 || r.sample_hash != 0 || r.tb_rate != 0 {
+		r.sampling = 1
+	}
+}
+
+// SampleEvery enables deterministic sampling of 1 in n packets
+// received, the rest is dropped in C before it is exposed with Next()
+// or NextBatch(). Sampling is applied after the filter, see
+// SetFilter() for the details on packets dropping. n of 0 or 1
+// disables sampling.
+func (rr *RingReader) SampleEvery(n int) {
+	rr.reader.sample_every = C.uint32_t(n)
+	rr.reader.sample_cnt = 0
+	rr.updateSampling()
+}
+
+// SampleFlows enables sampling of flows by hash calculated by the
+// NIC, approximately 1 in n flows is kept entirely and packets of
+// other flows are dropped. n of 0 or 1 disables sampling.
+func (rr *RingReader) SampleFlows(n int) {
+	rr.reader.sample_hash = 0
+	if n > 1 {
+		rr.reader.sample_hash = C.uint32_t((1 << 32) / uint64(n))
+	}
+	rr.updateSampling()
+}
+
+// SetRateLimit enables token bucket limiting of packets exposed to
+// the user to pps packets per second with bursts of up to burst
+// packets. Tokens are refilled according to hardware timestamps of
+// the packets. Limiting is applied after the filter and sampling.
+// pps of 0 disables limiting.
+func (rr *RingReader) SetRateLimit(pps, burst int) {
+	if burst < 1 {
+		burst = 1
+	}
+
+	r := rr.reader
+	r.tb_rate = C.uint64_t(pps)
+	r.tb_depth = C.uint64_t(burst) * 1e9
+	r.tb_tokens = r.tb_depth
+	if pps > 0 {
+		r.tb_fill = r.tb_depth / r.tb_rate
+	}
+	r.tb_last = 0
+	rr.updateSampling()
+}
+
+// Sampled returns number of packets dropped by sampling and rate
+// limiting respectively.
+func (rr *RingReader) Sampled() (sampled, limited uint64) {
+	return uint64(rr.reader.sampled), uint64(rr.reader.limited)
+}
+
+// SetArena specifies Arena to copy packets into in ReadPacketData().
+// Packets copied this way should be returned to the arena by the user
+// with Arena's Release() or Reset(). If a is nil, packets are copied
+// to newly allocated slices.
+func (rr *RingReader) SetArena(a *Arena) {
+	rr.arena = a
+}
+
+// copyData makes a copy of packet data to retain beyond the burst.
+func (rr *RingReader) copyData(data []byte) []byte {
+	if rr.arena != nil {
+		return rr.arena.Copy(data)
+	}
+	return append(make([]byte, 0, len(data)), data...)
+}
+
+// ReaderCounters is a snapshot of RingReader telemetry counters.
+type ReaderCounters struct {
+	// Number of packets received, including filtered out
+	Pkts uint64
+	// Number of borrowed bytes of received packets
+	Bytes uint64
+	// Number of successful receive calls
+	Bursts uint64
+	// Burst size the reader was created with
+	BurstSize int
+}
+
+// FillRatio returns average ratio of received packets to the burst
+// size per receive call. Ratio close to 1 means the ring is not
+// drained fast enough.
+func (c *ReaderCounters) FillRatio() float64 {
+	if c.Bursts == 0 {
+		return 0
+	}
+	return float64(c.Pkts) / float64(c.Bursts*uint64(c.BurstSize))
+}
+
+// Rates returns packet and byte rates per second since prev snapshot
+// taken d time before.
+func (c *ReaderCounters) Rates(prev *ReaderCounters, d time.Duration) (pps, bps float64) {
+	if sec := d.Seconds(); sec > 0 {
+		pps = float64(c.Pkts-prev.Pkts) / sec
+		bps = float64(c.Bytes-prev.Bytes) * 8 / sec
+	}
+	return
+}
+
+// Counters returns snapshot of telemetry counters of the reader. It
+// requires no cgo calls and may be called from another goroutine in
+// which case values are approximate.
+func (rr *RingReader) Counters() ReaderCounters {
+	return ReaderCounters{
+		Pkts:      uint64(rr.reader.pkts),
+		Bytes:     uint64(rr.reader.bytes),
+		Bursts:    uint64(rr.reader.bursts),
+		BurstSize: int(rr.reader.nreq_in),
+	}
+}
+
+// SetAdaptive enables adaptive mode of the reader in which the burst
+// size and the timeout passed to snf_ring_recv_many() are adjusted to
+// the observed arrival rate.
+//
+// Under high load, as bursts get filled up, the burst size grows up to
+// burst specified in NewReader() (throughput target) and the reader
+// switches to busy-polling of the ring with 0 timeout. Under low load,
+// the burst size shrinks down to minBurst (latency target) so that
+// processed packets get returned to the ring sooner. After idlePolls
+// consecutive empty polls the reader switches back to blocking
+// receive with the timeout specified in NewReader(). While polling,
+// Next() returns EAGAIN error on every empty poll so LoopNext() is
+// advised.
+//
+// Adaptive mode is only applicable if burst specified in NewReader()
+// is greater than 1. If minBurst is not positive, adaptive mode is
+// disabled.
+func (rr *RingReader) SetAdaptive(minBurst, idlePolls int) {
+	r := rr.reader
+	if minBurst <= 0 || r.nreq_in == 1 {
+		r.adaptive = 0
+		r.nreq_cur = r.nreq_in
+		r.polling = 0
+		return
+	}
+
+	if C.int(minBurst) > r.nreq_in {
+		minBurst = int(r.nreq_in)
+	}
+	if idlePolls <= 0 {
+		idlePolls = 1
+	}
+
+	r.nreq_min = C.int(minBurst)
+	r.nreq_cur = C.int(minBurst)
+	r.idle_max = C.int(idlePolls)
+	r.idle = 0
+	r.polling = 0
+	r.adaptive = 1
+}
+
+// Burst returns current effective burst size and whether the reader
+// is busy-polling the ring in adaptive mode.
+func (rr *RingReader) Burst() (burst int, polling bool) {
+	return int(rr.reader.nreq_cur), rr.reader.polling != 0
+}
+
+// QInfo returns queue consumption information of the ring as it was
+// reported by SNF upon the last receive or return of a burst. It
+// requires no cgo calls and may be used for backpressure decisions,
+// e.g. to throttle processing when Free() space is getting low.
+//
+// The information is only updated if burst specified in NewReader()
+// is greater than 1, i.e. snf_ring_recv_many() is used.
+func (rr *RingReader) QInfo() *RingQInfo {
+	return (*RingQInfo)(&rr.reader.qinfo)
+}
+
+// recharge returns current burst to the ring and receives the new
+// one.
+func (rr *RingReader) recharge() bool {
+	if atomic.LoadUint32(&rr.stopped) > 0 {
+		rr.err = &ErrSignal{rr.sig}
+		return false
+	}
+
+	return rr.recharged(C.ring_reader_recharge(rr.reader))
+}
+
+// recharged updates RingReader state after the underlying reader was
+// recharged with return code rc.
+func (rr *RingReader) recharged(rc C.int) bool {
+	rr.pendBytes, rr.pendPkts = 0, 0
+	rr.err = retErr(rc)
+	if rr.err != nil {
+		rr.reader.nreq_out = 0
+		rr.burst = rr.reqs[:0]
 		rr.n = 0
+		return false
 	}
 
+	rr.burst = rr.reqs[:rr.reader.nreq_out]
+	rr.recordLatency()
 	return true
 }
 
+// NextBatch gets next burst of packets out of ring. If the current
+// burst was partially consumed with Next(), the rest of it is
+// returned. Otherwise, the current burst is returned to the ring and
+// a new one is received. If nil is returned, you should halt all
+// actions on the receiver until Err() error is examined and needed
+// actions are performed.
+//
+// The returned slice aliases the descriptors privately held by
+// RingReader and it is valid until the next call to Next(),
+// NextBatch() or Free(). Iterating over the slice doesn't involve any
+// cgo calls. RecvReq() and Data() point to the last packet of the
+// returned burst.
+func (rr *RingReader) NextBatch() []RecvReq {
+	if rr.n+1 >= len(rr.burst) {
+		if !rr.recharge() {
+			return nil
+		}
+		rr.n = -1
+	}
+
+	reqs := rr.burst[rr.n+1:]
+	rr.n = len(rr.burst) - 1
+	return reqs
+}
+
 func (rr *RingReader) req() *RecvReq {
-	return rr.recvReq(rr.n)
+	return &rr.reqs[rr.n]
 }
 
 // RecvReq returns current packet descriptor. This descriptor points
@@ -145,6 +526,9 @@ func (rr *RingReader) Err() error {
 // matter of good code style.
 func (rr *RingReader) Free() error {
 	C.ring_reader_return_many(rr.reader)
+	rr.burst = rr.reqs[:0]
+	rr.n = 0
+	rr.pendBytes, rr.pendPkts = 0, 0
 	return nil
 }
 
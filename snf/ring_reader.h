@@ -1,6 +1,7 @@
 #ifndef _RING_READER_H_
 #define _RING_READER_H_
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -10,11 +11,65 @@
 #include <snf.h>
 #endif
 
+/*
+ * Packet filter callback. Return non-0 if packet should be passed to
+ * the user.
+ */
+typedef int (ring_reader_filter_fn) (struct snf_recv_req *, void *);
+
+/*
+ * Burst callback invoked for every burst of packets delivered to the
+ * user, after the filter is applied.
+ */
+typedef void (ring_reader_burst_fn) (struct snf_recv_req *, int, void *);
+
+/*
+ * Number of consecutive bursts to receive and drop entirely by the
+ * filter before giving control back to the caller.
+ */
+#define RING_READER_FILTER_LOOPS 64
+
 struct ring_reader {
 	snf_ring_t ringh;
 	int timeout_ms;
 	int nreq_out;
 	int nreq_in; // allocated elements of req_vector
+	int nreq_ret; // descriptors already returned from req_vector
+	uint32_t data_qlen; // borrowed and not yet returned bytes
+	struct snf_ring_qinfo qinfo; // as of last receive or return
+
+	ring_reader_filter_fn *filter;
+	void *filter_ctx;
+	uint64_t filtered; // packets dropped by filter
+
+	ring_reader_burst_fn *burst_fn;
+	void *burst_ctx;
+
+	// sampling, see ring_reader_sample()
+	int sampling; // any of sampling stages is enabled
+	uint32_t sample_every; // keep 1 in sample_every packets
+	uint32_t sample_cnt;
+	uint32_t sample_hash; // keep flows with scrambled hw_hash below
+	uint64_t tb_rate; // token bucket rate, packets per second
+	uint64_t tb_depth; // bucket depth, packets * 1e9
+	uint64_t tb_fill; // nanoseconds to fill the bucket
+	uint64_t tb_tokens; // packets * 1e9
+	uint64_t tb_last; // timestamp of the last refill
+	uint64_t sampled; // packets dropped by 1-in-N or hash sampling
+	uint64_t limited; // packets dropped by token bucket
+
+	// telemetry counters
+	uint64_t pkts; // received packets
+	uint64_t bytes; // borrowed bytes of received packets
+	uint64_t bursts; // successful receive calls
+
+	// adaptive mode, see ring_reader_adapt()
+	int adaptive;
+	int nreq_cur; // effective nreq_in
+	int nreq_min;
+	int polling; // non-blocking receive is used
+	int idle; // consecutive empty polls
+	int idle_max;
 
 	struct snf_recv_req req_vector[0];
 };
@@ -35,16 +90,17 @@ ring_reader_size(int nreq_in)
 }
 
 /*
- * Return number of borrowed bytes by counting length_data from all
- * received packets in the reader.
+ * Return number of borrowed bytes by counting length_data from
+ * received packets in the reader starting from index 'from' up to
+ * but not including index 'to'.
  */
 static uint32_t
-ring_reader_data_qlen(struct ring_reader *reader)
+ring_reader_data_qlen(struct ring_reader *reader, int from, int to)
 {
 	int i;
 	uint32_t data_qlen = 0;
 
-	for (i = 0; i < reader->nreq_out; i++) {
+	for (i = from; i < to; i++) {
 		data_qlen += reader->req_vector[i].length_data;
 	}
 
@@ -52,23 +108,118 @@ ring_reader_data_qlen(struct ring_reader *reader)
 }
 
 /*
- * Receive packets for the reader.
+ * Adjust effective burst size and timeout after receiving nreq
+ * packets with return code rc.
+ *
+ * If burst is filled, burst size is doubled up to nreq_in and reader
+ * switches to non-blocking receive. If burst is less than a quarter
+ * full, burst size is halved down to nreq_min. After idle_max
+ * consecutive empty non-blocking receive attempts the reader switches
+ * back to blocking receive with timeout_ms.
+ */
+static void
+ring_reader_adapt(struct ring_reader *reader, int rc, int nreq)
+{
+	if (rc == EAGAIN) {
+		if (reader->polling && ++reader->idle >= reader->idle_max) {
+			reader->polling = 0;
+			reader->idle = 0;
+			reader->nreq_cur = reader->nreq_min;
+		}
+		return;
+	}
+
+	if (rc != 0) {
+		return;
+	}
+
+	reader->idle = 0;
+	if (reader->nreq_out >= nreq) {
+		reader->nreq_cur = nreq * 2 < reader->nreq_in ? nreq * 2 : reader->nreq_in;
+		reader->polling = 1;
+	} else if (reader->nreq_out * 4 <= nreq) {
+		reader->nreq_cur = nreq / 2 > reader->nreq_min ? nreq / 2 : reader->nreq_min;
+	}
+}
+
+/*
+ * Receive packets for the reader with specified timeout.
  *
  * 0 if received some packets.
  * non-0 if encountered some error.
  */
 static int
-ring_reader_recv_many(struct ring_reader *reader)
+ring_reader_recv_many(struct ring_reader *reader, int timeout_ms)
 {
+	int rc, nreq = reader->nreq_in;
+
 	if (reader->nreq_in == 1) {
-		int rc = snf_ring_recv(reader->ringh, reader->timeout_ms, &reader->req_vector[0]);
+		rc = snf_ring_recv(reader->ringh, timeout_ms, &reader->req_vector[0]);
 		reader->nreq_out = !rc;
+		if (rc == 0) {
+			reader->pkts++;
+			reader->bytes += reader->req_vector[0].length_data;
+			reader->bursts++;
+		}
 		return rc;
 	}
 
+	if (reader->adaptive) {
+		nreq = reader->nreq_cur;
+		timeout_ms = reader->polling ? 0 : timeout_ms;
+	}
+
 	reader->nreq_out = 0;
-	return snf_ring_recv_many(reader->ringh, reader->timeout_ms, reader->req_vector,
-			reader->nreq_in, &reader->nreq_out, NULL);
+	reader->nreq_ret = 0;
+	rc = snf_ring_recv_many(reader->ringh, timeout_ms, reader->req_vector,
+			nreq, &reader->nreq_out, &reader->qinfo);
+
+	// account borrowed bytes while descriptors are still hot in
+	// cache. Note that qinfo.q_borrowed is not used since it
+	// covers all data borrowed from the ring, not only by reader.
+	reader->data_qlen = ring_reader_data_qlen(reader, 0, reader->nreq_out);
+	if (rc == 0) {
+		reader->pkts += reader->nreq_out;
+		reader->bytes += reader->data_qlen;
+		reader->bursts++;
+	}
+
+	if (reader->adaptive) {
+		ring_reader_adapt(reader, rc, nreq);
+	}
+	return rc;
+}
+
+/*
+ * Return data_qlen borrowed bytes of the packets in the reader up to
+ * but not including index n. data_qlen should be the sum of
+ * length_data of packets since the last return. SNF returns data in
+ * FIFO order so only the consumed prefix of the burst may be returned
+ * this way.
+ */
+static int
+ring_reader_return_upto(struct ring_reader *reader, int n, uint32_t data_qlen)
+{
+	int rc = 0;
+
+	if (n <= reader->nreq_ret) {
+		return 0;
+	}
+
+	if (data_qlen > reader->data_qlen) {
+		return EINVAL;
+	}
+
+	if (data_qlen > 0) {
+		rc = snf_ring_return_many(reader->ringh, data_qlen, &reader->qinfo);
+	}
+
+	if (rc == 0) {
+		reader->nreq_ret = n;
+		reader->data_qlen -= data_qlen;
+	}
+
+	return rc;
 }
 
 /*
@@ -79,30 +230,209 @@ ring_reader_return_many(struct ring_reader *reader)
 {
 	int rc = 0;
 
-	if (reader->nreq_in > 1) {
+	if (reader->nreq_in > 1 && reader->data_qlen > 0) {
 		// it makes sense to return only if packets were received with
 		// snf_ring_recv_many i.e. more than one descriptor is
-		// supplied.
-		rc = snf_ring_return_many(reader->ringh, ring_reader_data_qlen(reader), NULL);
+		// supplied. Return by data_qlen rather than by packets since
+		// a burst dropped entirely by filter or sampling holds data
+		// but no packets.
+		rc = snf_ring_return_many(reader->ringh, reader->data_qlen,
+				&reader->qinfo);
 	}
 
 	reader->nreq_out = 0;
+	reader->nreq_ret = 0;
+	reader->data_qlen = 0;
 	return rc;
 }
 
+/*
+ * Apply filter to received packets compacting req_vector to only
+ * matching packets. Borrowed bytes of dropped packets are still
+ * accounted in data_qlen.
+ *
+ * Return number of matching packets.
+ */
+static int
+ring_reader_filter(struct ring_reader *reader)
+{
+	int i, n = 0;
+
+	for (i = 0; i < reader->nreq_out; i++) {
+		struct snf_recv_req *req = &reader->req_vector[i];
+		if (reader->filter(req, reader->filter_ctx)) {
+			if (n != i) {
+				reader->req_vector[n] = *req;
+			}
+			n++;
+		}
+	}
+
+	reader->filtered += reader->nreq_out - n;
+	reader->nreq_out = n;
+	return n;
+}
+
+/*
+ * Scramble hash value so that any range of it selects a uniform
+ * portion of flows (murmur3 finalizer).
+ */
+static uint32_t
+ring_reader_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/*
+ * Check if the packet conforms to token bucket. Tokens are refilled
+ * according to hardware timestamps of packets.
+ */
+static int
+ring_reader_tb_conform(struct ring_reader *reader, uint64_t ts)
+{
+	uint64_t elapsed = ts > reader->tb_last ? ts - reader->tb_last : 0;
+
+	reader->tb_last = ts > reader->tb_last ? ts : reader->tb_last;
+	if (elapsed >= reader->tb_fill) {
+		reader->tb_tokens = reader->tb_depth;
+	} else {
+		reader->tb_tokens += elapsed * reader->tb_rate;
+		if (reader->tb_tokens > reader->tb_depth) {
+			reader->tb_tokens = reader->tb_depth;
+		}
+	}
+
+	if (reader->tb_tokens < 1000000000ULL) {
+		return 0;
+	}
+
+	reader->tb_tokens -= 1000000000ULL;
+	return 1;
+}
+
+/*
+ * Apply sampling stages to received packets compacting req_vector to
+ * only sampled packets: deterministic 1-in-N sampling, hash-based
+ * sampling of flows and token bucket rate limiting, in that order.
+ * Borrowed bytes of dropped packets are still accounted in data_qlen.
+ *
+ * Return number of sampled packets.
+ */
+static int
+ring_reader_sample(struct ring_reader *reader)
+{
+	int i, n = 0;
+
+	for (i = 0; i < reader->nreq_out; i++) {
+		struct snf_recv_req *req = &reader->req_vector[i];
+
+		if (reader->sample_every > 1 &&
+				++reader->sample_cnt < reader->sample_every) {
+			reader->sampled++;
+			continue;
+		}
+		reader->sample_cnt = 0;
+
+		if (reader->sample_hash != 0 &&
+				ring_reader_mix(req->hw_hash) >= reader->sample_hash) {
+			reader->sampled++;
+			continue;
+		}
+
+		if (reader->tb_rate != 0 && !ring_reader_tb_conform(reader, req->timestamp)) {
+			reader->limited++;
+			continue;
+		}
+
+		if (n != i) {
+			reader->req_vector[n] = *req;
+		}
+		n++;
+	}
+
+	reader->nreq_out = n;
+	return n;
+}
+
+/*
+ * Return borrowed bytes and receive new packets with specified
+ * timeout.
+ *
+ * If filter or sampling is installed, bursts with no matching packets
+ * are returned and received again without leaving the function for at
+ * most RING_READER_FILTER_LOOPS times, after which EAGAIN is
+ * returned. Burst callback, if installed, is invoked on the received
+ * burst.
+ */
+static int
+ring_reader_recharge_timeout(struct ring_reader *reader, int timeout_ms)
+{
+	int rc, loops = 0;
+
+	for (;;) {
+		if ((reader->nreq_out > 0 || reader->data_qlen > 0) &&
+				((rc = ring_reader_return_many(reader)) != 0)) {
+			return rc;
+		}
+
+		if ((rc = ring_reader_recv_many(reader, timeout_ms)) != 0) {
+			return rc;
+		}
+
+		if ((reader->filter != NULL && ring_reader_filter(reader) == 0) ||
+				(reader->sampling && ring_reader_sample(reader) == 0)) {
+			if (++loops >= RING_READER_FILTER_LOOPS) {
+				return EAGAIN;
+			}
+			continue;
+		}
+
+		if (reader->burst_fn != NULL) {
+			reader->burst_fn(reader->req_vector, reader->nreq_out,
+					reader->burst_ctx);
+		}
+		return 0;
+	}
+}
+
 /*
  * Return borrowed bytes and receive new packets.
  */
 static int
 ring_reader_recharge(struct ring_reader *reader)
 {
-	int rc;
+	return ring_reader_recharge_timeout(reader, reader->timeout_ms);
+}
+
+/*
+ * Recharge one of n readers, e.g. opened on the physical rings of an
+ * aggregated ring. Readers are polled with no timeout in round-robin
+ * fashion starting from the one next to *cur. If none of them has
+ * packets, the one next to *cur is recharged with its timeout.
+ *
+ * *cur is updated with the index of the last recharged reader.
+ */
+static int
+ring_reader_recharge_any(struct ring_reader **readers, int n, int *cur)
+{
+	int i, k, rc;
 
-	if (reader->nreq_out > 0 && ((rc = ring_reader_return_many(reader)) != 0)) {
-		return rc;
+	for (i = 1; i <= n; i++) {
+		k = (*cur + i) % n;
+		rc = ring_reader_recharge_timeout(readers[k], 0);
+		if (rc != EAGAIN) {
+			*cur = k;
+			return rc;
+		}
 	}
 
-	return ring_reader_recv_many(reader);
+	*cur = k = (*cur + 1) % n;
+	return ring_reader_recharge(readers[k]);
 }
 
 #endif /* _RING_READER_H_ */
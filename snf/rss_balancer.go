@@ -0,0 +1,163 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "rss_hash.h"
+*/
+import "C"
+
+import (
+	"sync/atomic"
+	"syscall"
+	"unsafe"
+)
+
+// RssBalancerBuckets is the number of hash buckets RssBalancer maps
+// to rings.
+const RssBalancerBuckets = C.RSS_BALANCER_BUCKETS
+
+// RssBalancer is an RSS hash function which distributes packets into
+// hash buckets and maps buckets to rings via a table which is
+// adjusted at runtime to offload hot buckets from overloaded rings.
+//
+// Packets are assigned to buckets with the symmetric Toeplitz hash,
+// see HandlerOptRssHash. Please be aware that moving a bucket to
+// another ring may reorder packets of the flows in that bucket.
+type RssBalancer struct {
+	b      *C.struct_rss_balancer
+	nrings int
+	prev   []uint64
+	delta  []uint64
+}
+
+// NewRssBalancer creates RssBalancer for nrings rings, which should
+// match the number of rings the Handle is opened with. flags is a mask
+// of RssHashL4 and RssHashInner. Initially, buckets are spread
+// across rings evenly.
+//
+// RssBalancer should be freed with Free() once the Handle is closed.
+// EINVAL is returned if nrings is not positive.
+func NewRssBalancer(nrings int, flags int) (*RssBalancer, error) {
+	if nrings <= 0 {
+		return nil, syscall.EINVAL
+	}
+
+	b := (*C.struct_rss_balancer)(C.calloc(1, C.sizeof_struct_rss_balancer))
+	if b == nil {
+		return nil, syscall.ENOMEM
+	}
+	b.flags = C.int(flags)
+	for i := range b.table {
+		b.table[i] = C.uint32_t(i % nrings)
+	}
+
+	return &RssBalancer{
+		b:      b,
+		nrings: nrings,
+		prev:   make([]uint64, RssBalancerBuckets),
+		delta:  make([]uint64, RssBalancerBuckets),
+	}, nil
+}
+
+// HandlerOpt returns HandlerOption which specifies RssBalancer as the
+// RSS hash function.
+//
+// Note that this option unsets HandlerOptRssFlags, HandlerOptRssFunc
+// and HandlerOptRssHash options.
+func (rb *RssBalancer) HandlerOpt() HandlerOption {
+	return HandlerOption{func(opts *handlerOpts) {
+		opts.rss = &C.struct_snf_rss_params{}
+		C.set_rss_balancer(opts.rss, rb.b)
+	}}
+}
+
+// Free releases memory of RssBalancer. It should only be called after
+// the Handle is closed.
+func (rb *RssBalancer) Free() {
+	C.free(unsafe.Pointer(rb.b))
+	rb.b = nil
+}
+
+// Ring returns ring which the bucket is mapped to.
+func (rb *RssBalancer) Ring(bucket int) int {
+	return int(atomic.LoadUint32((*uint32)(&rb.b.table[bucket])))
+}
+
+// Move maps the bucket to the ring. EINVAL is returned if either the
+// bucket or the ring is out of range.
+func (rb *RssBalancer) Move(bucket, ring int) error {
+	if bucket < 0 || bucket >= RssBalancerBuckets || ring < 0 || ring >= rb.nrings {
+		return syscall.EINVAL
+	}
+	rb.move(bucket, ring)
+	return nil
+}
+
+func (rb *RssBalancer) move(bucket, ring int) {
+	atomic.StoreUint32((*uint32)(&rb.b.table[bucket]), uint32(ring))
+}
+
+// update calculates packet counts per bucket since the last update.
+func (rb *RssBalancer) update() {
+	for i := range rb.prev {
+		hits := atomic.LoadUint64((*uint64)(&rb.b.hits[i]))
+		rb.delta[i] = hits - rb.prev[i]
+		rb.prev[i] = hits
+	}
+}
+
+// Rebalance calculates per-ring load from the number of packets hit
+// every bucket since the last call and, if the most loaded ring
+// exceeds the average load by more than threshold (e.g. 0.2 means
+// 20%), moves its hottest bucket which doesn't overload the least
+// loaded ring to the latter. Rebalance should be called periodically.
+//
+// Ring loads in packets are returned, along with the moved bucket or
+// -1 if no bucket was moved.
+func (rb *RssBalancer) Rebalance(threshold float64) (load []uint64, moved int) {
+	rb.update()
+
+	load = make([]uint64, rb.nrings)
+	var total uint64
+	for i, d := range rb.delta {
+		load[rb.Ring(i)] += d
+		total += d
+	}
+
+	hot, cold := 0, 0
+	for i := range load {
+		if load[i] > load[hot] {
+			hot = i
+		}
+		if load[i] < load[cold] {
+			cold = i
+		}
+	}
+
+	avg := float64(total) / float64(rb.nrings)
+	if total == 0 || float64(load[hot]) <= avg*(1+threshold) {
+		return load, -1
+	}
+
+	// moving bucket of d packets is beneficial only if d is less
+	// than the gap between rings.
+	moved = -1
+	gap := load[hot] - load[cold]
+	for i, d := range rb.delta {
+		if rb.Ring(i) == hot && d < gap && (moved < 0 || d > rb.delta[moved]) {
+			moved = i
+		}
+	}
+
+	if moved >= 0 {
+		rb.move(moved, cold)
+		load[hot] -= rb.delta[moved]
+		load[cold] += rb.delta[moved]
+	}
+	return load, moved
+}
@@ -0,0 +1,38 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf_test
+
+import (
+	"syscall"
+	"testing"
+
+	"github.com/yerden/go-snf/snf"
+)
+
+func TestRssBalancerInvalid(t *testing.T) {
+	assert := newAssert(t, false)
+
+	for _, n := range []int{0, -1} {
+		_, err := snf.NewRssBalancer(n, 0)
+		assert(err == syscall.EINVAL, n, err)
+	}
+
+	rb, err := snf.NewRssBalancer(4, snf.RssHashL4)
+	assert(err == nil, err)
+	defer rb.Free()
+
+	assert(rb.Move(0, 4) == syscall.EINVAL)
+	assert(rb.Move(0, -1) == syscall.EINVAL)
+	assert(rb.Move(-1, 0) == syscall.EINVAL)
+	assert(rb.Move(snf.RssBalancerBuckets, 0) == syscall.EINVAL)
+
+	assert(rb.Move(5, 3) == nil)
+	assert(rb.Ring(5) == 3)
+
+	load, moved := rb.Rebalance(0.2)
+	assert(len(load) == 4 && moved == -1, load, moved)
+}
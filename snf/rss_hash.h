@@ -0,0 +1,273 @@
+#ifndef _RSS_HASH_H_
+#define _RSS_HASH_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wrapper.h"
+
+/*
+ * Flags for built-in RSS hash function, passed as a context.
+ */
+enum {
+	RSS_HASH_L4 = 0x1, // include TCP/UDP/SCTP ports
+	RSS_HASH_INNER = 0x2, // hash inner headers of VXLAN and GTP-U
+};
+
+#define RSS_HASH_VXLAN_PORT 4789
+#define RSS_HASH_GTPU_PORT 2152
+
+/*
+ * Toeplitz key which makes the hash symmetric, i.e. both directions
+ * of a flow produce the same hash value. Should be at least 4 bytes
+ * longer than the longest tuple (IPv6 addresses and ports).
+ */
+static const uint8_t rss_hash_sym_key[40] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+static uint32_t
+rss_hash_toeplitz(const uint8_t *key, const uint8_t *data, int len)
+{
+	uint32_t hash = 0;
+	uint32_t v = (uint32_t)key[0] << 24 | (uint32_t)key[1] << 16 |
+		(uint32_t)key[2] << 8 | key[3];
+	int i, b;
+
+	for (i = 0; i < len; i++) {
+		for (b = 7; b >= 0; b--) {
+			if (data[i] & (1 << b)) {
+				hash ^= v;
+			}
+			v = v << 1 | ((key[i + 4] >> b) & 1);
+		}
+	}
+
+	return hash;
+}
+
+static int rss_hash_parse_eth(const uint8_t *p, uint32_t len, int flags,
+		uint8_t *tuple, int depth);
+
+/*
+ * Return offset of inner IP header in GTP-U G-PDU message or 0 if
+ * message is not G-PDU or is malformed.
+ */
+static uint32_t
+rss_hash_gtpu_off(const uint8_t *g, uint32_t len)
+{
+	uint32_t off = 8;
+	uint8_t next;
+
+	// version 1, G-PDU message type
+	if (len < off || (g[0] >> 5) != 1 || g[1] != 0xff) {
+		return 0;
+	}
+
+	// sequence number, N-PDU number or extension header present
+	if (g[0] & 0x07) {
+		if (len < (off += 4)) {
+			return 0;
+		}
+
+		for (next = (g[0] & 0x04) ? g[11] : 0; next != 0; ) {
+			uint32_t extlen;
+
+			if (len < off + 1 || (extlen = g[off] * 4) == 0 || len < off + extlen) {
+				return 0;
+			}
+			next = g[off + extlen - 1];
+			off += extlen;
+		}
+	}
+
+	return off;
+}
+
+/*
+ * Parse IP header and fill tuple with addresses and, if requested,
+ * ports. Tunnelled packets are parsed for inner headers if requested.
+ *
+ * Return the length of the tuple or 0 if not an IP packet.
+ */
+static int
+rss_hash_parse_ip(const uint8_t *p, uint32_t len, int flags, uint8_t *tuple,
+		int depth)
+{
+	const uint8_t *l4;
+	uint32_t l4len;
+	int n, proto, ports = 1;
+
+	if (len < 1) {
+		return 0;
+	}
+
+	if ((p[0] >> 4) == 4) {
+		uint32_t ihl = (p[0] & 0xf) * 4;
+		if (ihl < 20 || len < ihl) {
+			return 0;
+		}
+		proto = p[9];
+		// ports are only in the first fragment, so all fragments
+		// are hashed on addresses to be kept together
+		ports = ((p[6] & 0x3f) | p[7]) == 0;
+		memcpy(tuple, p + 12, 8);
+		n = 8;
+		l4 = p + ihl;
+		l4len = len - ihl;
+	} else if ((p[0] >> 4) == 6) {
+		if (len < 40) {
+			return 0;
+		}
+		proto = p[6];
+		memcpy(tuple, p + 8, 32);
+		n = 32;
+		l4 = p + 40;
+		l4len = len - 40;
+	} else {
+		return 0;
+	}
+
+	if (!ports || l4len < 4 || (proto != 6 && proto != 17 && proto != 132)) {
+		return n;
+	}
+
+	if (proto == 17 && (flags & RSS_HASH_INNER) && depth == 0 && l4len >= 8) {
+		uint16_t dport = (uint16_t)l4[2] << 8 | l4[3];
+		int inner = 0;
+		uint32_t off;
+
+		if (dport == RSS_HASH_VXLAN_PORT && l4len >= 16) {
+			inner = rss_hash_parse_eth(l4 + 16, l4len - 16, flags, tuple, depth + 1);
+		} else if (dport == RSS_HASH_GTPU_PORT &&
+				(off = rss_hash_gtpu_off(l4 + 8, l4len - 8)) > 0) {
+			inner = rss_hash_parse_ip(l4 + 8 + off, l4len - 8 - off, flags,
+					tuple, depth + 1);
+		}
+
+		if (inner > 0) {
+			return inner;
+		}
+
+		// restore outer addresses which may be overwritten
+		return rss_hash_parse_ip(p, len, flags & ~RSS_HASH_INNER, tuple, depth);
+	}
+
+	if (flags & RSS_HASH_L4) {
+		memcpy(tuple + n, l4, 4);
+		n += 4;
+	}
+
+	return n;
+}
+
+/*
+ * Parse Ethernet header skipping VLAN tags and MPLS labels.
+ *
+ * Return the length of the tuple or 0 if not an IP packet.
+ */
+static int
+rss_hash_parse_eth(const uint8_t *p, uint32_t len, int flags, uint8_t *tuple,
+		int depth)
+{
+	uint32_t off = 14;
+	uint16_t type;
+
+	if (len < off) {
+		return 0;
+	}
+
+	for (type = (uint16_t)p[12] << 8 | p[13];
+			type == 0x8100 || type == 0x88a8 || type == 0x9100;
+			off += 4) {
+		if (len < off + 4) {
+			return 0;
+		}
+		type = (uint16_t)p[off + 2] << 8 | p[off + 3];
+	}
+
+	if (type == 0x8847 || type == 0x8848) {
+		// skip label stack up to bottom of stack label, IP version
+		// is determined by the first nibble
+		do {
+			if (len < off + 4) {
+				return 0;
+			}
+			off += 4;
+		} while ((p[off - 2] & 0x01) == 0);
+	} else if (type != 0x0800 && type != 0x86dd) {
+		return 0;
+	}
+
+	return rss_hash_parse_ip(p + off, len - off, flags, tuple, depth);
+}
+
+/*
+ * Return symmetric Toeplitz hash of IP addresses and, optionally,
+ * ports of the packet or 0 if not an IP packet.
+ */
+static uint32_t
+rss_hash_sym(struct snf_recv_req *r, int flags)
+{
+	uint8_t tuple[36];
+	int n = rss_hash_parse_eth(r->pkt_addr, r->length, flags, tuple, 0);
+
+	return n > 0 ? rss_hash_toeplitz(rss_hash_sym_key, tuple, n) : 0;
+}
+
+/*
+ * rss_hash_fn implementation hashing IP addresses and, optionally,
+ * ports with symmetric Toeplitz hash. ctx carries RSS_HASH_* flags.
+ */
+static int
+rss_hash_sym_toeplitz(struct snf_recv_req *r, void *ctx, uint32_t *hashval)
+{
+	*hashval = rss_hash_sym(r, (int)(uintptr_t)ctx);
+	return 0;
+}
+
+static void
+set_rss_hash(struct snf_rss_params *rss, int flags)
+{
+	set_rss_func(rss, rss_hash_sym_toeplitz, (void *)(uintptr_t)flags);
+}
+
+/*
+ * Number of hash buckets for rebalancing RSS. Must be power of 2.
+ */
+#define RSS_BALANCER_BUCKETS 256
+
+/*
+ * Context of rebalancing RSS hash function. Packets are distributed
+ * to buckets by the symmetric Toeplitz hash, each bucket is mapped to
+ * a ring via table which may be altered at runtime.
+ */
+struct rss_balancer {
+	int flags; // RSS_HASH_* flags
+	uint32_t table[RSS_BALANCER_BUCKETS]; // bucket to ring mapping
+	uint64_t hits[RSS_BALANCER_BUCKETS]; // packets count per bucket
+};
+
+static int
+rss_balancer_hash(struct snf_recv_req *r, void *ctx, uint32_t *hashval)
+{
+	struct rss_balancer *b = ctx;
+	uint32_t bucket = rss_hash_sym(r, b->flags) & (RSS_BALANCER_BUCKETS - 1);
+
+	__atomic_fetch_add(&b->hits[bucket], 1, __ATOMIC_RELAXED);
+	*hashval = __atomic_load_n(&b->table[bucket], __ATOMIC_RELAXED);
+	return 0;
+}
+
+static void
+set_rss_balancer(struct snf_rss_params *rss, struct rss_balancer *b)
+{
+	set_rss_func(rss, rss_balancer_hash, b);
+}
+
+#endif /* _RSS_HASH_H_ */
@@ -0,0 +1,139 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"encoding/binary"
+	"syscall"
+	"testing"
+	"unsafe"
+)
+
+// toeplitz is the reference Toeplitz hash over the tuple.
+func toeplitz(key, tuple []byte) (hash uint32) {
+	for i := range tuple {
+		for b := uint(0); b < 8; b++ {
+			if tuple[i]&(0x80>>b) != 0 {
+				pos := uint(i)*8 + b
+				for j := uint(0); j < 32; j++ {
+					k := pos + j
+					hash ^= uint32(key[k/8]>>(7-k%8)&1) << (31 - j)
+				}
+			}
+		}
+	}
+	return
+}
+
+// ipFrame crafts Ethernet frame of IP packet with L4 ports. Addresses
+// are 4 bytes long for IPv4 and 16 bytes long for IPv6.
+func ipFrame(proto byte, src, dst []byte, sport, dport uint16) []byte {
+	be := binary.BigEndian
+	var data, l4 []byte
+	if len(src) == 4 {
+		data = make([]byte, 14+20+8+16)
+		be.PutUint16(data[12:], 0x0800)
+		ip := data[14:]
+		ip[0] = 0x45
+		be.PutUint16(ip[2:], uint16(len(ip)))
+		ip[8] = 64
+		ip[9] = proto
+		copy(ip[12:], src)
+		copy(ip[16:], dst)
+		l4 = ip[20:]
+	} else {
+		data = make([]byte, 14+40+8+16)
+		be.PutUint16(data[12:], 0x86dd)
+		ip := data[14:]
+		ip[0] = 0x60
+		be.PutUint16(ip[4:], uint16(len(ip)-40))
+		ip[6] = proto
+		ip[7] = 64
+		copy(ip[8:], src)
+		copy(ip[24:], dst)
+		l4 = ip[40:]
+	}
+	be.PutUint16(l4[0:], sport)
+	be.PutUint16(l4[2:], dport)
+	return data
+}
+
+// hashFrame returns the built-in RSS hash of the frame. Packet data
+// resides outside of Go memory so the request may be passed to C.
+func hashFrame(t *testing.T, frame []byte, flags int) uint32 {
+	data, err := syscall.Mmap(-1, 0, len(frame), syscall.PROT_READ|syscall.PROT_WRITE,
+		syscall.MAP_ANON|syscall.MAP_PRIVATE)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer syscall.Munmap(data)
+	copy(data, frame)
+
+	var req RecvReq
+	req.pkt_addr = unsafe.Pointer(&data[0])
+	*(*uint32)(unsafe.Pointer(&req.length)) = uint32(len(data))
+	return rssHash(&req, flags)
+}
+
+func TestRssHashSymmetric(t *testing.T) {
+	key := make([]byte, 40)
+	for i := range key {
+		key[i] = []byte{0x6d, 0x5a}[i%2]
+	}
+
+	addrs := [][2][]byte{
+		{{10, 0, 0, 1}, {192, 168, 200, 17}},
+		{{0xfe, 0x80, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14},
+			{0x20, 0x01, 0x0d, 0xb8, 0xff, 0xfe, 0, 0, 0, 0, 0, 0, 0xca, 0xfe, 0xba, 0xbe}},
+	}
+
+	for _, a := range addrs {
+		for _, proto := range []byte{6, 17, 132} {
+			for _, flags := range []int{0, RssHashL4} {
+				fwd := hashFrame(t, ipFrame(proto, a[0], a[1], 40000, 443), flags)
+				rev := hashFrame(t, ipFrame(proto, a[1], a[0], 443, 40000), flags)
+				if fwd != rev {
+					t.Errorf("%v proto %d flags %d: %#x != %#x", a, proto, flags, fwd, rev)
+				}
+
+				tuple := append(append([]byte{}, a[0]...), a[1]...)
+				if flags&RssHashL4 != 0 {
+					tuple = append(tuple, 40000>>8, 40000&0xff, 443>>8, 443&0xff)
+				}
+				if want := toeplitz(key, tuple); fwd != want {
+					t.Errorf("%v proto %d flags %d: %#x, want %#x", a, proto, flags, fwd, want)
+				}
+			}
+
+			// ports are hashed
+			h1 := hashFrame(t, ipFrame(proto, a[0], a[1], 40000, 443), RssHashL4)
+			h2 := hashFrame(t, ipFrame(proto, a[0], a[1], 40001, 443), RssHashL4)
+			if h1 == h2 {
+				t.Errorf("%v proto %d: ports not hashed", a, proto)
+			}
+		}
+	}
+
+	// fragments of a datagram are hashed on addresses
+	v4 := addrs[0]
+	want := hashFrame(t, ipFrame(17, v4[0], v4[1], 40000, 443), 0)
+	for _, frag := range [][2]byte{{0x20, 0}, {0x20, 0xb9}, {0, 0xb9}, {0x01, 0}} {
+		frame := ipFrame(17, v4[0], v4[1], 40000, 443)
+		frame[14+6], frame[14+7] = frag[0], frag[1]
+		if h := hashFrame(t, frame, RssHashL4); h != want {
+			t.Errorf("fragment %#x: %#x, want %#x", frag, h, want)
+		}
+	}
+
+	// non-IP packet
+	frame := ipFrame(17, addrs[0][0], addrs[0][1], 1, 2)
+	frame[12] = 0x08
+	frame[13] = 0x06
+	if h := hashFrame(t, frame, RssHashL4); h != 0 {
+		t.Errorf("ARP hashed to %#x", h)
+	}
+}
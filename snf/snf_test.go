@@ -44,6 +44,9 @@ func setup(t *testing.T) (func(*testing.T), error) {
 	assert := newAssert(t, false)
 
 	var err error
+	appID, appIDSet := os.LookupEnv("SNF_APP_ID")
+	numRings, numRingsSet := os.LookupEnv("SNF_NUM_RINGS")
+
 	// set app id
 	err = os.Setenv("SNF_APP_ID", "32")
 	assert(err == nil)
@@ -52,7 +55,19 @@ func setup(t *testing.T) (func(*testing.T), error) {
 	err = os.Setenv("SNF_NUM_RINGS", "2")
 	assert(err == nil)
 
-	return func(t *testing.T) {}, snf.Init()
+	return func(t *testing.T) {
+		// restore environment for other tests
+		restoreEnv("SNF_APP_ID", appID, appIDSet)
+		restoreEnv("SNF_NUM_RINGS", numRings, numRingsSet)
+	}, snf.Init()
+}
+
+func restoreEnv(name, value string, ok bool) {
+	if ok {
+		os.Setenv(name, value)
+	} else {
+		os.Unsetenv(name)
+	}
 }
 
 func TestInit(t *testing.T) {
@@ -101,21 +116,21 @@ func TestHandleRing(t *testing.T) {
 	assertFail(err == nil)
 
 	ifa, err := snf.GetIfAddrs()
-	assert(err == nil)
-	assert(len(ifa) > 0)
+	assertFail(err == nil, err)
+	assertFail(len(ifa) > 0)
 
 	portnum := ifa[0].PortNum()
 	h, err := snf.OpenHandle(portnum)
-	assert(err == nil)
-	assert(h != nil)
+	assertFail(err == nil, err)
+	assertFail(h != nil)
 
 	r0, err := h.OpenRing()
-	assert(err == nil)
-	assert(r0 != nil)
+	assertFail(err == nil, err)
+	assertFail(r0 != nil)
 
 	r1, err := h.OpenRing()
-	assert(err == nil)
-	assert(r1 != nil)
+	assertFail(err == nil, err)
+	assertFail(r1 != nil)
 
 	_, err = h.OpenRing()
 	assert(err == syscall.EBUSY)
@@ -145,25 +160,24 @@ func TestApp(t *testing.T) {
 
 	assertFail(err == nil)
 	ifa, err := snf.GetIfAddrs()
-	assert(err == nil)
-
-	assert(len(ifa) > 0)
+	assertFail(err == nil, err)
+	assertFail(len(ifa) > 0)
 
 	var wg sync.WaitGroup
 	counters := make([]uint64, len(ifa))
 	// handle all ports
 	for i := range ifa {
 		h, err := snf.OpenHandle(ifa[i].PortNum())
-		assert(err == nil)
-		assert(h != nil)
+		assertFail(err == nil, err)
+		assertFail(h != nil)
 		defer h.Close()
 
 		// opening SNF_NUM_RINGS rings
 		var rings []*snf.Ring
 		for x := 0; x < 2; x++ {
 			r, err := h.OpenRing()
-			assert(err == nil)
-			assert(r != nil)
+			assertFail(err == nil, err)
+			assertFail(r != nil)
 			defer r.Close()
 			rings = append(rings, r)
 		}
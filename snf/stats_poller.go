@@ -0,0 +1,276 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"math"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+)
+
+const (
+	ringStatsWords   = int(unsafe.Sizeof(RingStats{}) / 8)
+	injectStatsWords = int(unsafe.Sizeof(InjectStats{}) / 8)
+
+	// stats words followed by time and rates
+	ringEntryWords   = ringStatsWords + 4
+	injectEntryWords = injectStatsWords + 3
+)
+
+// statsEntry is a seqlock protected snapshot of stats words. There
+// should be a single writer.
+type statsEntry struct {
+	seq   uint64
+	words []uint64
+}
+
+func (e *statsEntry) store(src []uint64) {
+	atomic.AddUint64(&e.seq, 1)
+	for i := range src {
+		atomic.StoreUint64(&e.words[i], src[i])
+	}
+	atomic.AddUint64(&e.seq, 1)
+}
+
+func (e *statsEntry) load(dst []uint64) {
+	for {
+		seq := atomic.LoadUint64(&e.seq)
+		if seq&1 != 0 {
+			continue
+		}
+		for i := range dst {
+			dst[i] = atomic.LoadUint64(&e.words[i])
+		}
+		if atomic.LoadUint64(&e.seq) == seq {
+			return
+		}
+	}
+}
+
+// RingStatsSnapshot is a snapshot of receive ring statistics taken by
+// StatsPoller along with rates calculated since the previous one.
+type RingStatsSnapshot struct {
+	RingStats
+
+	// Time the snapshot was taken.
+	Time time.Time
+
+	// Packets per second received into the ring.
+	Pps float64
+
+	// Bits per second received by the NIC.
+	Bps float64
+
+	// Ratio of packets dropped by the NIC, the ring or SNF buffering
+	// to all packets seen.
+	DropRatio float64
+}
+
+// InjectStatsSnapshot is a snapshot of injection handle statistics
+// taken by StatsPoller along with rates calculated since the previous
+// one.
+type InjectStatsSnapshot struct {
+	InjectStats
+
+	// Time the snapshot was taken.
+	Time time.Time
+
+	// Packets per second sent by the injection handle.
+	Pps float64
+
+	// Bits per second sent by the NIC.
+	Bps float64
+}
+
+type ringPoll struct {
+	r     *Ring
+	cur   RingStats
+	prev  RingStats
+	ts    int64
+	entry statsEntry
+}
+
+type injectPoll struct {
+	h     *InjectHandle
+	cur   InjectStats
+	prev  InjectStats
+	ts    int64
+	entry statsEntry
+}
+
+// StatsPoller periodically collects statistics of receive rings and
+// injection handles into a preallocated table. Readers of the table
+// get the latest snapshots without cgo calls or allocations, so
+// monitoring doesn't perturb capture threads.
+//
+// Rings and injection handles should be added before Start().
+type StatsPoller struct {
+	interval time.Duration
+	rings    []*ringPoll
+	injs     []*injectPoll
+	words    [ringEntryWords]uint64
+
+	stop    chan struct{}
+	stopped uint32
+	wg      sync.WaitGroup
+}
+
+// NewStatsPoller creates StatsPoller which collects statistics every
+// interval.
+func NewStatsPoller(interval time.Duration) *StatsPoller {
+	return &StatsPoller{interval: interval, stop: make(chan struct{})}
+}
+
+// AddRing adds receive ring to poll and returns its index in the
+// table.
+func (p *StatsPoller) AddRing(r *Ring) int {
+	p.rings = append(p.rings, &ringPoll{
+		r:     r,
+		entry: statsEntry{words: make([]uint64, ringEntryWords)},
+	})
+	return len(p.rings) - 1
+}
+
+// AddInject adds injection handle to poll and returns its index in
+// the table.
+func (p *StatsPoller) AddInject(h *InjectHandle) int {
+	p.injs = append(p.injs, &injectPoll{
+		h:     h,
+		entry: statsEntry{words: make([]uint64, injectEntryWords)},
+	})
+	return len(p.injs) - 1
+}
+
+func rate(cur, prev uint64, sec float64) float64 {
+	return float64(cur-prev) / sec
+}
+
+func (p *StatsPoller) pollRing(rp *ringPoll, now int64) {
+	if rp.r.getStats(&rp.cur) != nil {
+		return
+	}
+
+	w := p.words[:ringEntryWords]
+	copy(w, (*[ringStatsWords]uint64)(unsafe.Pointer(&rp.cur))[:])
+	w[ringStatsWords] = uint64(now)
+
+	var pps, bps, drop float64
+	if sec := float64(now-rp.ts) / 1e9; rp.ts != 0 && sec > 0 {
+		cur, prev := &rp.cur, &rp.prev
+		pps = rate(cur.RingPktRecv, prev.RingPktRecv, sec)
+		bps = rate(cur.NicBytesRecv, prev.NicBytesRecv, sec) * 8
+		dropped := cur.NicPktOverflow - prev.NicPktOverflow +
+			cur.RingPktOverflow - prev.RingPktOverflow +
+			cur.SnfPktOverflow - prev.SnfPktOverflow
+		if seen := cur.RingPktRecv - prev.RingPktRecv + dropped; seen > 0 {
+			drop = float64(dropped) / float64(seen)
+		}
+	}
+	w[ringStatsWords+1] = math.Float64bits(pps)
+	w[ringStatsWords+2] = math.Float64bits(bps)
+	w[ringStatsWords+3] = math.Float64bits(drop)
+
+	rp.entry.store(w)
+	rp.prev, rp.ts = rp.cur, now
+}
+
+func (p *StatsPoller) pollInject(ip *injectPoll, now int64) {
+	if ip.h.getStats(&ip.cur) != nil {
+		return
+	}
+
+	w := p.words[:injectEntryWords]
+	copy(w, (*[injectStatsWords]uint64)(unsafe.Pointer(&ip.cur))[:])
+	w[injectStatsWords] = uint64(now)
+
+	var pps, bps float64
+	if sec := float64(now-ip.ts) / 1e9; ip.ts != 0 && sec > 0 {
+		pps = rate(ip.cur.InjPktSend(), ip.prev.InjPktSend(), sec)
+		bps = rate(ip.cur.NicBytesSend(), ip.prev.NicBytesSend(), sec) * 8
+	}
+	w[injectStatsWords+1] = math.Float64bits(pps)
+	w[injectStatsWords+2] = math.Float64bits(bps)
+
+	ip.entry.store(w)
+	ip.prev, ip.ts = ip.cur, now
+}
+
+// Poll collects statistics of all rings and injection handles once.
+// It should not be called concurrently with itself or while the
+// poller is started.
+func (p *StatsPoller) Poll() {
+	for _, rp := range p.rings {
+		p.pollRing(rp, time.Now().UnixNano())
+	}
+	for _, ip := range p.injs {
+		p.pollInject(ip, time.Now().UnixNano())
+	}
+}
+
+// Start launches background goroutine collecting statistics every
+// interval.
+func (p *StatsPoller) Start() {
+	p.wg.Add(1)
+	go func() {
+		defer p.wg.Done()
+		t := time.NewTicker(p.interval)
+		defer t.Stop()
+
+		for p.Poll(); ; p.Poll() {
+			select {
+			case <-p.stop:
+				return
+			case <-t.C:
+			}
+		}
+	}()
+}
+
+// Stop stops background goroutine and waits for it to exit. It may
+// be called more than once or without Start().
+func (p *StatsPoller) Stop() {
+	if atomic.SwapUint32(&p.stopped, 1) == 0 {
+		close(p.stop)
+	}
+	p.wg.Wait()
+}
+
+// Ring returns the latest snapshot of ring i statistics. Time is zero
+// if no snapshot was taken yet. It may be called from any goroutine.
+func (p *StatsPoller) Ring(i int, s *RingStatsSnapshot) {
+	var w [ringEntryWords]uint64
+	p.rings[i].entry.load(w[:])
+
+	*(*[ringStatsWords]uint64)(unsafe.Pointer(&s.RingStats)) =
+		*(*[ringStatsWords]uint64)(unsafe.Pointer(&w[0]))
+	s.Time = time.Time{}
+	if ts := int64(w[ringStatsWords]); ts != 0 {
+		s.Time = time.Unix(0, ts)
+	}
+	s.Pps = math.Float64frombits(w[ringStatsWords+1])
+	s.Bps = math.Float64frombits(w[ringStatsWords+2])
+	s.DropRatio = math.Float64frombits(w[ringStatsWords+3])
+}
+
+// Inject returns the latest snapshot of injection handle i
+// statistics. Time is zero if no snapshot was taken yet. It may be
+// called from any goroutine.
+func (p *StatsPoller) Inject(i int, s *InjectStatsSnapshot) {
+	var w [injectEntryWords]uint64
+	p.injs[i].entry.load(w[:])
+
+	*(*[injectStatsWords]uint64)(unsafe.Pointer(&s.InjectStats)) =
+		*(*[injectStatsWords]uint64)(unsafe.Pointer(&w[0]))
+	s.Time = time.Time{}
+	if ts := int64(w[injectStatsWords]); ts != 0 {
+		s.Time = time.Unix(0, ts)
+	}
+	s.Pps = math.Float64frombits(w[injectStatsWords+1])
+	s.Bps = math.Float64frombits(w[injectStatsWords+2])
+}
@@ -0,0 +1,69 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+import (
+	"sync"
+	"testing"
+	"time"
+)
+
+func TestStatsEntry(t *testing.T) {
+	const words, stores = ringEntryWords, 100000
+
+	e := &statsEntry{words: make([]uint64, words)}
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		src := make([]uint64, words)
+		for k := uint64(1); k <= stores; k++ {
+			for i := range src {
+				src[i] = k
+			}
+			e.store(src)
+		}
+	}()
+
+	var wg sync.WaitGroup
+	for r := 0; r < 4; r++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			dst := make([]uint64, words)
+			for last := uint64(0); last < stores; {
+				e.load(dst)
+				for i := range dst {
+					if dst[i] != dst[0] {
+						t.Errorf("torn snapshot: %v", dst)
+						return
+					}
+				}
+				if dst[0] < last {
+					t.Errorf("snapshot went back from %d to %d", last, dst[0])
+					return
+				}
+				last = dst[0]
+			}
+		}()
+	}
+
+	wg.Wait()
+	<-done
+}
+
+func TestStatsPollerStop(t *testing.T) {
+	// not started
+	p := NewStatsPoller(time.Millisecond)
+	p.Stop()
+	p.Stop()
+
+	p = NewStatsPoller(time.Millisecond)
+	p.Start()
+	time.Sleep(3 * time.Millisecond)
+	p.Stop()
+	p.Stop()
+}
@@ -0,0 +1,85 @@
+// Copyright 2019 Yerden Zhumabekov. All rights reserved.
+//
+// Use of this source code is governed by MIT license which
+// can be found in the LICENSE file in the root of the source
+// tree.
+
+package snf
+
+/*
+#include "wrapper.h"
+#include "warmup.h"
+*/
+import "C"
+
+import (
+	"time"
+	"unsafe"
+)
+
+// WarmupInfo describes the results of warming up rings.
+type WarmupInfo struct {
+	// Bytes is the size of data regions touched.
+	Bytes uint64
+
+	// Touch is the time spent touching the data regions.
+	Touch time.Duration
+
+	// PollCost is the average time of polling an idle ring with 0
+	// timeout. It estimates the cost of an empty receive.
+	PollCost time.Duration
+}
+
+// Warmup prepares the ring for capture so that the first bursts are
+// processed at steady state rate. Every page of data regions of the
+// ring's physical rings (see PortInfo()) is touched to populate page
+// tables, and the ring is polled polls times to warm up the receive
+// path and calibrate PollCost.
+//
+// Warmup should be called after the ring is opened but before
+// Handle's Start(), otherwise packets received while polling are
+// discarded.
+func (r *Ring) Warmup(polls int) (*WarmupInfo, error) {
+	pi, err := r.PortInfo()
+	if err != nil {
+		return nil, err
+	}
+
+	info := &WarmupInfo{}
+	start := time.Now()
+	for i := range pi {
+		data := pi[i].Data()
+		if len(data) > 0 {
+			C.warmup_touch(unsafe.Pointer(&data[0]), C.size_t(len(data)))
+		}
+		info.Bytes += uint64(len(data))
+	}
+	info.Touch = time.Since(start)
+
+	if polls > 0 {
+		ns := C.warmup_poll(C.snf_ring_t(unsafe.Pointer(r)), C.int(polls))
+		info.PollCost = time.Duration(uint64(ns) / uint64(polls))
+	}
+	return info, nil
+}
+
+// Warmup warms up opened rings of the handle, see Ring's Warmup(). It
+// should be called after all the rings are opened but before Start().
+// The returned info sums up the data touched by all rings while
+// PollCost is the highest one.
+func (h *Handle) Warmup(polls int, rings ...*Ring) (*WarmupInfo, error) {
+	total := &WarmupInfo{}
+	for _, r := range rings {
+		info, err := r.Warmup(polls)
+		if err != nil {
+			return nil, err
+		}
+
+		total.Bytes += info.Bytes
+		total.Touch += info.Touch
+		if info.PollCost > total.PollCost {
+			total.PollCost = info.PollCost
+		}
+	}
+	return total, nil
+}
@@ -0,0 +1,90 @@
+#ifndef _WARMUP_H_
+#define _WARMUP_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "wrapper.h"
+
+#define WARMUP_PAGE_SIZE 4096
+#define WARMUP_HUGEPAGE_SIZE (2 << 20)
+
+/*
+ * Read a byte of every page of the memory region so its page table
+ * entries are populated before the hot path hits them.
+ *
+ * Return the sum of read bytes so the reads are not optimized away.
+ */
+static uint64_t
+warmup_touch(const void *addr, size_t len)
+{
+	const volatile uint8_t *p = addr;
+	uint64_t sum = 0;
+	size_t off;
+
+	for (off = 0; off < len; off += WARMUP_PAGE_SIZE) {
+		sum += p[off];
+	}
+	if (len > 0) {
+		sum += p[len - 1];
+	}
+	return sum;
+}
+
+/*
+ * Allocate zeroed memory of size bytes aligned to a page, or to a
+ * huge page if size is at least a huge page, and fault it in. Pages
+ * are therefore allocated on the NUMA node of the calling thread.
+ *
+ * Return NULL if out of memory. The memory should be released with
+ * free().
+ */
+static void *
+warmup_alloc(size_t size)
+{
+	size_t align = size >= WARMUP_HUGEPAGE_SIZE ?
+		WARMUP_HUGEPAGE_SIZE : WARMUP_PAGE_SIZE;
+	void *p;
+
+	size = (size + align - 1) & ~(align - 1);
+	if (posix_memalign(&p, align, size) != 0) {
+		return NULL;
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (align == WARMUP_HUGEPAGE_SIZE) {
+		madvise(p, size, MADV_HUGEPAGE);
+	}
+#endif
+
+	memset(p, 0, size);
+	return p;
+}
+
+/*
+ * Poll the ring n times with 0 timeout. The ring is supposed to be
+ * idle, i.e. the capture is not started yet.
+ *
+ * Return elapsed time in nanoseconds.
+ */
+static uint64_t
+warmup_poll(snf_ring_t ring, int n)
+{
+	struct snf_recv_req req;
+	struct timespec t0, t1;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++) {
+		snf_ring_recv(ring, 0, &req);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000 +
+		t1.tv_nsec - t0.tv_nsec;
+}
+
+#endif /* _WARMUP_H_ */
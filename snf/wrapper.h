@@ -115,193 +115,7 @@ struct snf_rss_params {
 	} params;
 };
 
-static int snf_init(uint16_t api_version)
-{
-	return ENOTSUP;
-}
-
-static int snf_set_app_id(int32_t id)
-{
-	return ENOTSUP;
-}
-
-static int snf_getifaddrs(struct snf_ifaddrs **ifaddrs_o)
-{
-	return ENOTSUP;
-}
-
-static void snf_freeifaddrs(struct snf_ifaddrs *ifaddrs)
-{
-}
-
-static int snf_getportmask_valid(uint32_t * mask_o, int *cnt_o)
-{
-	return ENOTSUP;
-}
-
-static int snf_getportmask_linkup(uint32_t * mask_o, int *cnt_o)
-{
-	return ENOTSUP;
-}
-
-static int snf_open(uint32_t portnum,
-		    int num_rings,
-		    const struct snf_rss_params *rss_params,
-		    int64_t dataring_sz, int flags, snf_handle_t * devhandle)
-{
-	return ENOTSUP;
-}
-
-static int snf_open_defaults(uint32_t portnum, snf_handle_t * devhandle)
-{
-	return ENOTSUP;
-}
-
-static int snf_start(snf_handle_t devhandle)
-{
-	return ENOTSUP;
-}
-
-static int snf_stop(snf_handle_t devhandle)
-{
-	return ENOTSUP;
-}
-
-static int snf_get_link_state(snf_handle_t devhandle,
-			      enum snf_link_state *state)
-{
-	return ENOTSUP;
-}
-
-static int snf_get_timesource_state(snf_handle_t devhandle,
-				    enum snf_timesource_state *state)
-{
-	return ENOTSUP;
-}
-
-static int snf_get_link_speed(snf_handle_t devhandle, uint64_t * speed)
-{
-	return ENOTSUP;
-}
-
-static int snf_close(snf_handle_t devhandle)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_open(snf_handle_t devhandle, snf_ring_t * ringh)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_open_id(snf_handle_t devhandle, int ring_id,
-			    snf_ring_t * ringh)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_close(snf_ring_t ringh)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_recv(snf_ring_t ringh, int timeout_ms,
-			 struct snf_recv_req *recv_req)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_portinfo_count(snf_ring_t ring, int *count)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_portinfo(snf_ring_t ring,
-			     struct snf_ring_portinfo *portinfo)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_recv_qinfo(snf_ring_t ring, struct snf_ring_qinfo *qi)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_recv_many(snf_ring_t ring, int timeout_ms,
-			      struct snf_recv_req *req_vector, int nreq_in,
-			      int *nreq_out, struct snf_ring_qinfo *qinfo)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_return_many(snf_ring_t ring, uint32_t data_qlen,
-				struct snf_ring_qinfo *qinfo)
-{
-	return ENOTSUP;
-}
-
-static int snf_ring_getstats(snf_ring_t ringh, struct snf_ring_stats *stats)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_open(int portnum, int flags, snf_inject_t * handle)
-{
-	return ENOTSUP;
-}
-
-static int snf_get_injection_speed(snf_inject_t devhandle, uint64_t * speed)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_send(snf_inject_t inj, int timeout_ms, int flags,
-			   const void *pkt, uint32_t length)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_sched(snf_inject_t inj, int timeout_ms, int flags,
-			    const void *pkt, uint32_t length, uint64_t delay_ns)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_send_v(snf_inject_t inj, int timeout_ms, int flags,
-			     struct snf_pkt_fragment *frags_vec, int nfrags,
-			     uint32_t length_hint)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_sched_v(snf_inject_t inj, int timeout_ms, int flags,
-			      struct snf_pkt_fragment *frags_vec, int nfrags,
-			      uint32_t length_hint, uint64_t delay_ns)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_close(snf_inject_t inj)
-{
-	return ENOTSUP;
-}
-
-static int snf_inject_getstats(snf_inject_t inj, struct snf_inject_stats *stats)
-{
-	return ENOTSUP;
-}
-
-static int snf_netdev_reflect_enable(snf_handle_t hsnf,
-				     snf_netdev_reflect_t * handle)
-{
-	return ENOTSUP;
-}
-
-static int snf_netdev_reflect(snf_netdev_reflect_t ref_dev, const void *pkt,
-			      uint32_t length)
-{
-	return ENOTSUP;
-}
+#include "mockup.h"
 #endif
 
 static void add_rss_flags(struct snf_rss_params *rss, int flags)
@@ -367,5 +181,53 @@ static struct compound_int get_timesource_state(snf_handle_t h)
 	return out;
 }
 
+/*
+ * Inject packets of received descriptors straight from the ring
+ * memory. Returns the number of injected packets and the first error.
+ */
+static struct compound_int inject_recv_reqs(snf_inject_t inj, int timeout_ms,
+					    int flags,
+					    struct snf_recv_req *req_vector,
+					    int nreq)
+{
+	struct compound_int out;
+	int i;
+
+	out.rc = 0;
+	for (i = 0; i < nreq; i++) {
+		out.rc = snf_inject_send(inj, timeout_ms, flags,
+					 req_vector[i].pkt_addr,
+					 req_vector[i].length);
+		if (out.rc != 0)
+			break;
+	}
+
+	out.i[0] = i;
+	return out;
+}
+
+/*
+ * Reflect packets of received descriptors straight from the ring
+ * memory. Returns the number of reflected packets and the first error.
+ */
+static struct compound_int reflect_recv_reqs(snf_netdev_reflect_t ref_dev,
+					     struct snf_recv_req *req_vector,
+					     int nreq)
+{
+	struct compound_int out;
+	int i;
+
+	out.rc = 0;
+	for (i = 0; i < nreq; i++) {
+		out.rc = snf_netdev_reflect(ref_dev, req_vector[i].pkt_addr,
+					    req_vector[i].length);
+		if (out.rc != 0)
+			break;
+	}
+
+	out.i[0] = i;
+	return out;
+}
+
 #endif
 /* _WRAPPER_H_ */